@@ -0,0 +1,69 @@
+#include "graphical.h"
+#include "geometry.h"
+#include "console.h"
+#include "board.h"
+#include "object.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define WINDOW_WIDTH 800
+#define WINDOW_HEIGHT 600
+
+Window *mainWindow, *imageWindow, *consoleWindow;
+Viewport viewport = {{WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2 - 50}, 1.f};
+
+extern const char *errorText;
+
+static int usage() {
+    fprintf(stderr, "usage: ggb-batch [--coords <file|->] [--image <file.svg>] <script>...\n");
+    return 2;
+}
+
+// runs the scripts one after another with nothing drawn, then writes out what was asked for.
+// exits 1 on the first error
+int main(const int argc, char **argv) {
+    const char *coords = NULL, *image = NULL;
+    int countScripts = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--coords") == 0 || strcmp(argv[i], "--image") == 0) {
+            if (i + 1 == argc)
+                return usage();
+            *(argv[i][2] == 'c' ? &coords : &image) = argv[i + 1];
+            ++i;
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            return usage();
+        } else {
+            argv[++countScripts] = argv[i];
+        }
+    }
+    if (countScripts == 0)
+        return usage();
+
+    graphicalInit(1);
+    mainWindow = getNewWindow("GGB", WINDOW_WIDTH, WINDOW_HEIGHT);
+    imageWindow = getSubWindow(mainWindow, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT - 100);
+    consoleWindow = getSubWindow(mainWindow, 0, WINDOW_HEIGHT - 100, WINDOW_WIDTH, 100);
+    setRefreshMode(REFRESH_DISABLED);
+
+    for (int i = 1; i <= countScripts; ++i) {
+        const char *args[] = {"load-src", argv[i]};
+        if (executeCommand(2, args) != 0) {
+            fprintf(stderr, "%s: %s\n", argv[i], errorText);
+            return 1;
+        }
+    }
+
+    if (image != NULL) {
+        const char *args[] = {"render", image};
+        if (executeCommand(2, args) != 0) {
+            fprintf(stderr, "%s\n", errorText);
+            return 1;
+        }
+    }
+    if (coords != NULL && writeCoords(coords) != 0) {
+        fprintf(stderr, "Cannot write %s\n", coords);
+        return 1;
+    }
+    return 0;
+}
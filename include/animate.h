@@ -0,0 +1,6 @@
+#ifndef ANIMATE_H
+#define ANIMATE_H
+
+int animate(int argc, const char **argv);
+
+#endif //ANIMATE_H
@@ -3,12 +3,62 @@
 
 #include "object.h"
 
+// what the last refresh that repainted anything spent its time on
+typedef struct {
+    double frameMs, fillMs;
+    double circleMs, lineMs, pointMs; // summed over threads when drawn in tiles
+    double propagationMs; // the last movePoints
+    int drawn, culled; // culled: shown, near the repainted area per the pick grid, but off it
+} RenderStats;
+
+// while a script runs, refreshBoard only lets the damage pile up
+typedef enum {
+    REFRESH_IMMEDIATE,
+    REFRESH_DEFERRED,
+    REFRESH_DISABLED // not even presentBoard draws
+} RefreshMode;
+
 void refreshBoard();
 
+// refreshes whatever the mode
+void forceRefresh();
+
+// returns the mode it replaces
+RefreshMode setRefreshMode(RefreshMode mode);
+
+// the next refresh repaints the whole board
+void invalidateBoard();
+
+void presentBoard();
+
+const RenderStats *getRenderStats();
+
+void setStatsOverlay(int on);
+
+void markObjectChanged(GeomObject *obj);
+
+void markPointsMoved();
+
+void beginDynamic();
+
+void endDynamic();
+
+void forgetObject(GeomObject *obj);
+
+void resetBoard();
+
+void zoomBoard(int x, int y, float factor);
+
+void panBoard(Point2f origin);
+
 GeomObject *mouseSelect(int x, int y);
 
 int show(int argc, const char **argv);
 
 int hide(int argc, const char **argv);
 
+int render(int argc, const char **argv);
+
+int refresh(int argc, const char **argv);
+
 #endif //BOARD_H
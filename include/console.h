@@ -3,6 +3,11 @@
 
 int processCommand(char *buffer);
 
+// argv[0] names the command, every word NUL terminated
+int executeCommand(int argc, const char **argv);
+
 void console();
 
+void textConsole();
+
 #endif //CONSOLE_H
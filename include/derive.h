@@ -0,0 +1,31 @@
+#ifndef DERIVE_H
+#define DERIVE_H
+
+#include "points_manage.h"
+
+// below this many points a move is not worth waking the worker threads for
+#define PARALLEL_MIN_POINTS 4096
+
+typedef struct {
+    DeriveOp op;
+    int start, count;
+} TapeBatch;
+
+// a propagation order flattened to coordinate indices. within a level, points sharing an
+// opcode are stored next to each other and form one batch, which a kernel runs over in one go
+typedef struct {
+    int *dst, *src[MAX_PARENTS];
+    int length, capacity;
+    TapeBatch *batches;
+    int countBatches, batchCapacity;
+    int *levelBatches;
+    int levels, levelCapacity;
+} DeriveTape;
+
+Point2f deriveCoord(DeriveOp op, PointObject *const *parents);
+
+void buildTape(DeriveTape *tape, PointObject *const *order, const int *levelStart, int levels);
+
+void runTape(const DeriveTape *tape, int threads);
+
+#endif //DERIVE_H
@@ -0,0 +1,38 @@
+#ifndef DRAW_BATCH_H
+#define DRAW_BATCH_H
+
+#include "graphical.h"
+
+typedef enum {
+    BATCH_CIRCLES,
+    BATCH_LINES,
+    BATCH_POINTS,
+    BATCH_KIND_COUNT
+} BatchKind;
+
+// geometry waiting to be drawn, one packed array per kind so each goes out in a single call
+typedef struct {
+    Point2i *coords; // a point or circle center each, two line ends per line
+    int *radii, *colors;
+    Rect2i *bounds; // the pixels the item may touch, in the same coords
+    int count, capacity;
+} DrawBatch;
+
+// makes room for one more item
+void batchReserve(DrawBatch *batch, int coordsPerItem);
+
+// draws circles, lines, then points and empties the batches. on a large window, items that fit inside
+// one tile are drawn tile by tile on several threads, the rest afterwards on the whole window, so no
+// primitive gets clipped at a tile edge
+void flushBatches(const Window *window, DrawBatch *batches);
+
+// the time each kind took to draw since the last call, into ms[BATCH_KIND_COUNT].
+// tiles drawn on several threads add up, so this may exceed the wall time
+void takeBatchTimes(double *ms);
+
+// 0 leaves it to OpenMP, 1 draws the whole window in one pass
+void setRasterThreads(int threads);
+
+int getRasterThreads();
+
+#endif //DRAW_BATCH_H
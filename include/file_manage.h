@@ -3,4 +3,8 @@
 
 int load_src(int argc, const char **argv);
 
+int save_scene(int argc, const char **argv);
+
+int load_scene(int argc, const char **argv);
+
 #endif //FILE_MANAGE_H
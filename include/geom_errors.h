@@ -9,7 +9,8 @@ typedef enum {
     ERROR_INVALID_ARG,
     ERROR_UNKOWN_ARG,
     ERROR_NOT_FOUND_OBJECT,
-    ERROR_CANNOT_OPEN_FILE
+    ERROR_CANNOT_OPEN_FILE,
+    ERROR_DUPLICATE_NAME
 } GeomErrorType;
 
 const char *objectNotFound(const char *name);
@@ -26,8 +27,14 @@ const char *invalidArg(const char *arg, const char *tips);
 
 const char *unknownArgs(const char *arg);
 
+const char *duplicateName(const char *name);
+
+const char *errorInline(const char *error, int line);
+
 int throwError(GeomErrorType type, const char *text);
 
+int showMessage(const char *text);
+
 void resetError();
 
 #endif //GEOM_ERRORS_H
@@ -6,12 +6,12 @@
 
 #define A_HUGE_VALF ((float) 0x10000)
 
-static inline Point2i toImageCoord(const Point2f p, const Point2i origin) {
-    return (Point2i){(int) roundf(p.x) + origin.x, origin.y - (int) roundf(p.y)};
+static inline Point2i toImageCoord(const Point2f p, const Viewport view) {
+    return (Point2i){(int) roundf(view.origin.x + p.x * view.scale), (int) roundf(view.origin.y - p.y * view.scale)};
 }
 
-static inline Point2f toMathCoord(const Point2i p, const Point2i origin) {
-    return (Point2f){(float )(p.x - origin.x), (float)(origin.y - p.y)};
+static inline Point2f toMathCoord(const Point2i p, const Viewport view) {
+    return (Point2f){((float) p.x - view.origin.x) / view.scale, (view.origin.y - (float) p.y) / view.scale};
 }
 
 static inline float minf(const float a, const float b) {
@@ -70,4 +70,31 @@ static inline float vec3_dot(const Vector3f vec1, const Vector3f vec2) {
     return vec1.x * vec2.x + vec1.y * vec2.y + vec1.z * vec2.z;
 }
 
+static inline int rect_empty(const Rect2i r) {
+    return r.width <= 0 || r.height <= 0;
+}
+
+static inline int rect_overlap(const Rect2i a, const Rect2i b) {
+    return !rect_empty(a) && !rect_empty(b) &&
+           a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+static inline Rect2i rect_intersect(const Rect2i a, const Rect2i b) {
+    const int x = a.x > b.x ? a.x : b.x, y = a.y > b.y ? a.y : b.y;
+    const int right = a.x + a.width < b.x + b.width ? a.x + a.width : b.x + b.width;
+    const int bottom = a.y + a.height < b.y + b.height ? a.y + a.height : b.y + b.height;
+    return (Rect2i){x, y, right - x, bottom - y};
+}
+
+static inline Rect2i rect_union(const Rect2i a, const Rect2i b) {
+    if (rect_empty(a))
+        return b;
+    if (rect_empty(b))
+        return a;
+    const int x = a.x < b.x ? a.x : b.x, y = a.y < b.y ? a.y : b.y;
+    const int right = a.x + a.width > b.x + b.width ? a.x + a.width : b.x + b.width;
+    const int bottom = a.y + a.height > b.y + b.height ? a.y + a.height : b.y + b.height;
+    return (Rect2i){x, y, right - x, bottom - y};
+}
+
 #endif //ALL4ALGORITHM_GEOM_UTILS_H
@@ -22,4 +22,15 @@ typedef struct Vector3f
 
 typedef Point2f Vector2f;
 
+// screen = origin + scale * math, y pointing down on screen and up in math
+typedef struct Viewport {
+    Point2f origin;
+    float scale;
+} Viewport;
+
+typedef struct Rect2i {
+    int x, y;
+    int width, height;
+} Rect2i;
+
 #endif //POINT_VECTOR_H
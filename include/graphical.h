@@ -39,12 +39,17 @@ enum MouseEventFlags {
 extern "C" {
 #endif
 
-void graphicalInit();
+// offscreen keeps every window in memory. returns whether the backend ended up headless
+int graphicalInit(int offscreen);
 
 Window *getNewWindow(const char *name, int width, int height);
 
 Window *getSubWindow(const Window *window, int x, int y, int width, int height);
 
+void moveSubWindow(Window *sub, const Window *window, int x, int y, int width, int height);
+
+void windowCopy(const Window *dst, const Window *src);
+
 void windowFill(const Window *window, unsigned char r, unsigned char g, unsigned char b);
 
 void drawPoint(const Window *window, Point2i p, int rgb);
@@ -59,14 +64,29 @@ void drawPoly(const Window *window, const Point2i *points, int nponts, int rgb,
 
 void drawCircle(const Window *window, Point2i center, int radius, int rgb, int thickness);
 
+// packed arrays, colors[i] goes with the i-th primitive. a line takes ends[2i] and ends[2i + 1]
+void drawPointBatch(const Window *window, const Point2i *points, const int *colors, int count);
+
+void drawLineBatch(const Window *window, const Point2i *ends, const int *colors, int count, int thickness);
+
+void drawCircleBatch(const Window *window, const Point2i *centers, const int *radii, const int *colors, int count,
+                     int thickness);
+
+void windowRead(const Window *window, unsigned char *rgb);
+
 void drawText(const Window *window, const char *text, Point2i leftbottom, int rgb, int fontsize);
 
 char waitKey(int ms);
 
+// wheel notches from the flags of an EVENT_MOUSEWHEEL, positive forward
+int mouseWheelDelta(int flags);
+
 void setMouseCallback(const Window *window, void (*callback)(int event, int x, int y, int flags, void *userdata), void *userdata);
 
 void showWindow(const Window *window);
 
+int windowVisible(const Window *window);
+
 void destroyWindow(const Window *window);
 
 #ifdef __cplusplus
@@ -0,0 +1,18 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stddef.h>
+
+// a whole file mapped read-only. an empty file maps to data == NULL, size 0
+typedef struct {
+    const char *data;
+    size_t size;
+    void *handle;
+} MappedFile;
+
+// returns 0 on success
+int mapFile(const char *filename, MappedFile *file);
+
+void unmapFile(MappedFile *file);
+
+#endif //MAPPED_FILE_H
@@ -1,9 +1,14 @@
 #ifndef OBJECT_H
 #define OBJECT_H
 
-#include <stdint.h>
 #include "points_manage.h"
 
+#define OBJECT_DELETING 1
+#define OBJECT_CHANGED 2
+#define OBJECT_UNBOUNDED 4
+#define OBJECT_DYNAMIC 8
+#define OBJECT_LISTED 16
+
 typedef enum {
     ANY, POINT, CIRCLE, LINE, RAY, SEG
 } ObjectType;
@@ -13,14 +18,16 @@ typedef struct CircleObject_ CircleObject;
 typedef struct GeomObject_ GeomObject;
 typedef union ObjectSelector_ ObjectSelector;
 
+// lines and rays end wherever they leave the board, see clipLine in board.c
 struct LineObject_ {
     PointObject *pt1, *pt2;
-    PointObject *showPt1, *showPt2;
 };
 
+// radius is cached while center->version + pt->version still equals version
 struct CircleObject_ {
     PointObject *center, *pt;
     float radius;
+    unsigned version;
 };
 
 union ObjectSelector_ {
@@ -30,19 +37,50 @@ union ObjectSelector_ {
 };
 
 struct GeomObject_ {
-    unsigned long long id;
+    char *name;
     int show, color;
+    int flags;
     ObjectType type;
-    GeomObject *next;
+    unsigned serial; // creation order, newer objects win a pick
+    Rect2i bounds; // where it was last drawn on the board
+    unsigned boundsView; // the viewport version bounds belong to
+    Rect2i cells; // pick grid cells it is filed under
+    GeomObject *prev, *next;
     ObjectSelector ptr[0];
 };
 
-GeomObject *findObject(ObjectType type, uint64_t id);
+GeomObject *findObject(ObjectType type, const char *name);
+
+// what an object gets when no color is given
+int randomColor();
+
+// takes over arg's points. a NULL name gets a default one
+GeomObject *createGeomObject(ObjectType type, const ObjectSelector *arg, const char *name, int show, int rgb);
+
+// room for that many more objects of each kind, allocated up front
+void reserveGeomObjects(int countPoints, int countLines, int countCircles);
+
+// every object and point goes, without redrawing
+void clearScene();
+
+// removes the object, every point derived from it and every object drawn from those points
+void deleteObject(GeomObject *obj);
+
+// "name x y" per point, oldest first. "-" is stdout. returns 0 on success
+int writeCoords(const char *filename);
 
 int create(int argc, const char **argv);
 
+int clear(int argc, const char **argv);
+
+int delete_object(int argc, const char **argv);
+
 int midpoint(int argc, const char **argv);
 
 int move_pt(int argc, const char **argv);
 
+int lazy_eval(int argc, const char **argv);
+
+int set_threads(int argc, const char **argv);
+
 #endif //OBJECT_H
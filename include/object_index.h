@@ -0,0 +1,16 @@
+#ifndef OBJECT_INDEX_H
+#define OBJECT_INDEX_H
+
+#include "object.h"
+
+GeomObject *objectIndexFind(const char *name);
+
+void objectIndexInsert(GeomObject *obj);
+
+void objectIndexRemove(const GeomObject *obj);
+
+void objectIndexReserve(int more);
+
+void objectIndexClear();
+
+#endif //OBJECT_INDEX_H
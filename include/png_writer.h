@@ -0,0 +1,7 @@
+#ifndef PNG_WRITER_H
+#define PNG_WRITER_H
+
+// 8 bit rgb, rows packed. returns 0 on success
+int writePng(const char *filename, const unsigned char *rgb, int width, int height);
+
+#endif //PNG_WRITER_H
@@ -0,0 +1,9 @@
+#ifndef POINT_IMPORT_H
+#define POINT_IMPORT_H
+
+// import-points <file> [--raw]. a CSV has one "x,y[,name[,color]]" per line, blank lines and lines
+// starting with # are skipped. --raw takes the file as float32 x, y pairs. either way every point
+// goes in, or none does if one of them fails
+int import_points(int argc, const char **argv);
+
+#endif //POINT_IMPORT_H
@@ -3,28 +3,112 @@
 
 #include "geometry.h"
 
+#define MAX_PARENTS 2
+
+#define POINT_MARKED 1
+#define POINT_DIRTY 2
+
+// how a derived point is computed from its parents
+typedef enum {
+    DERIVE_NONE,
+    DERIVE_MIDPOINT,
+    DERIVE_OP_COUNT
+} DeriveOp;
+
 typedef struct PointObject_ PointObject;
 typedef struct SubPoint_ SubPoint;
+typedef struct ObjectLink_ ObjectLink;
 
 struct SubPoint_ {
     PointObject *pt;
     SubPoint *next;
 };
 
+// the objects (see object.h) that reference a point
+struct ObjectLink_ {
+    struct GeomObject_ *obj;
+    ObjectLink *next;
+};
+
+// topology only, the coordinates live in pointCoords at [index]
 struct PointObject_ {
-    Point2f coord;
+    int index;
     int indegree;
-    PointObject *next;
+    int numParents;
+    int flags;
     SubPoint *children;
+    ObjectLink *users;
 
-    Point2f (*derive)(PointObject **);
+    DeriveOp op;
 
     PointObject *parents[0];
 };
 
-PointObject *createPointData(Point2f pt, PointObject **parents, int numParents,
-                             Point2f (*derive)(PointObject **));
+// version is bumped on every write, so values cached from a point (e.g. a circle's radius) can tell they are stale
+typedef struct {
+    float *x, *y;
+    unsigned *version;
+    int count, capacity;
+} PointCoords;
+
+extern PointCoords pointCoords;
+
+void resolvePoint(PointObject *pt);
+
+// in lazy mode a moved descendant is only marked dirty, and gets derived here on first read
+static inline Point2f pointCoord(const PointObject *pt) {
+    if (pt->flags & POINT_DIRTY)
+        resolvePoint((PointObject *) pt);
+    return (Point2f){pointCoords.x[pt->index], pointCoords.y[pt->index]};
+}
+
+static inline unsigned pointVersion(const PointObject *pt) {
+    return pointCoords.version[pt->index];
+}
+
+static inline void setPointCoord(PointObject *pt, const Point2f p) {
+    pointCoords.x[pt->index] = p.x;
+    pointCoords.y[pt->index] = p.y;
+    pointCoords.version[pt->index]++;
+    pt->flags &= ~POINT_DIRTY;
+}
+
+// survives the point it names: resolving it after the point is deleted gives NULL
+typedef struct {
+    int index;
+    unsigned generation;
+} PointHandle;
+
+PointObject *createPointData(Point2f pt, PointObject **parents, int numParents, DeriveOp op);
+
+void reservePointData(const int *countByParents, int countUsers);
+
+void addPointUser(PointObject *pt, struct GeomObject_ *obj);
+
+void removePointUser(PointObject *pt, const struct GeomObject_ *obj);
+
+int collectDescendants(PointObject *root, PointObject ***descendants);
+
+void destroyPointData(PointObject *pt);
+
+PointHandle getPointHandle(const PointObject *pt);
+
+PointObject *resolvePointHandle(PointHandle handle);
 
 void movePoints(PointObject **pts, const Point2f *dst, int count);
 
+int getLastMoved(PointObject *const **moved);
+
+double getLastMoveMs();
+
+void setLazyEvaluation(int lazy);
+
+void setPropagationThreads(int threads);
+
+int getPropagationThreads();
+
+int getMaxThreads();
+
+void clearPointData();
+
 #endif //POINTS_MANAGE_H
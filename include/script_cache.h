@@ -0,0 +1,41 @@
+#ifndef SCRIPT_CACHE_H
+#define SCRIPT_CACHE_H
+
+#include "object.h"
+
+#include <stdint.h>
+
+// a script that ran through once is kept next to it (<script>.ggbc) as the ops it came down to: names
+// are resolved to the index of the object in the script's creation order, arguments are parsed. a script
+// touching objects it did not create, or running commands with no op, is not cached. the cache is keyed
+// by hashBytes of the script
+
+// 0 if the cache is missing or belongs to other contents, otherwise 1 and *error holds what replaying
+// returned, with *line the script line that failed
+int replayCache(const char *cacheName, uint64_t hash, int *error, int *line);
+
+// returns 0 when a recording is already running, a nested script then goes unrecorded
+int beginRecording();
+
+// writes the cache if the script kept to recordable commands
+void endRecording(const char *cacheName, uint64_t hash, int succeeded);
+
+// before every line of the recorded script. any command not listed here spoils the recording
+void recordCommand(const char *command, int line);
+
+// called by the commands once they succeeded. do nothing unless recording
+void recordCreate(const GeomObject *obj, int defaultName);
+
+void recordMove(GeomObject *const *src, GeomObject *const *dst, int count);
+
+void recordShow(const GeomObject *obj);
+
+void recordDelete(const GeomObject *obj);
+
+void recordLazy(int lazy);
+
+void recordThreads(int threads);
+
+void recordRefresh();
+
+#endif //SCRIPT_CACHE_H
@@ -0,0 +1,43 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+typedef struct SlabChunk_ SlabChunk;
+typedef struct Slab_ Slab;
+
+// fixed-size records carved out of large chunks, recycled through a free list
+struct Slab_ {
+    const char *name;
+    size_t elemSize;
+    int chunkCapacity;
+    int chunkUsed;
+    SlabChunk *chunks;
+    void *freeList;
+
+    long long allocCount, freeCount;
+    int chunkCount;
+    size_t chunkBytes;
+    int registered;
+    Slab *nextSlab;
+};
+
+#define SLAB_ALIGN(size) (((size) + 15) / 16 * 16)
+#define SLAB_INITIALIZER(slabName, size, perChunk) \
+    {.name = (slabName), .elemSize = SLAB_ALIGN(size), .chunkCapacity = (perChunk)}
+
+void *slabAlloc(Slab *slab);
+
+void slabFree(Slab *slab, void *ptr);
+
+void slabReserve(Slab *slab, int count);
+
+void slabRelease(Slab *slab);
+
+long long slabLiveCount(const Slab *slab);
+
+size_t slabBytes(const Slab *slab);
+
+const Slab *slabList();
+
+#endif //SLAB_H
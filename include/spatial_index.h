@@ -0,0 +1,14 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include "object.h"
+
+void spatialIndexUpdate(GeomObject *obj, Point2f min, Point2f max);
+
+void spatialIndexRemove(GeomObject *obj);
+
+int spatialIndexQuery(Point2f min, Point2f max, GeomObject *const **candidates);
+
+void spatialIndexClear();
+
+#endif //SPATIAL_INDEX_H
@@ -0,0 +1,8 @@
+#ifndef STATS_H
+#define STATS_H
+
+int stats(int argc, const char **argv);
+
+int bench(int argc, const char **argv);
+
+#endif //STATS_H
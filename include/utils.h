@@ -1,6 +1,7 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define STR_HASH64(c1, c2, c3, c4, c5, c6, c7, c8)( \
@@ -11,6 +12,10 @@
 
 uint64_t strhash64(const char *str);
 
+uint64_t hashBytes(const char *data, size_t size);
+
+uint64_t hashString(const char *str);
+
 int strtobool(const char *str, const char **endptr);
 
 uint32_t random32();
@@ -19,4 +24,6 @@ void randomSeed(uint64_t initstate, uint64_t initseq);
 
 const char *invalidColor();
 
+double getTimeMs();
+
 #endif //UTILS_H
@@ -2,20 +2,29 @@
 #include "geometry.h"
 #include "console.h"
 
+#include <string.h>
+
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 600
 
 Window *mainWindow, *imageWindow, *consoleWindow;
-Point2i origin = {WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2 - 50};
+Viewport viewport = {{WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2 - 50}, 1.f};
 
-int main(){
-    graphicalInit();
+int main(const int argc, char **argv) {
+    int headless = 0;
+    for (int i = 1; i < argc; ++i)
+        if (strcmp(argv[i], "--headless") == 0)
+            headless = 1;
+    headless = graphicalInit(headless);
 
     mainWindow = getNewWindow("GGB", WINDOW_WIDTH, WINDOW_HEIGHT);
     imageWindow = getSubWindow(mainWindow, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT - 100);
     consoleWindow = getSubWindow(mainWindow, 0, WINDOW_HEIGHT - 100, WINDOW_WIDTH, 100);
 
-    console();
+    if (headless)
+        textConsole();
+    else
+        console();
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include "animate.h"
+#include "board.h"
+#include "geom_errors.h"
+#include "geom_utils.h"
+#include "object.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the path is read once up front, so it stays put even if it hangs off the animated point
+typedef struct {
+    int circle;
+    Point2f p1, p2;
+    float radius;
+} AnimationPath;
+
+static AnimationPath getPath(GeomObject *obj) {
+    if (obj->type == CIRCLE) {
+        const Point2f center = pointCoord(obj->ptr->circle.center);
+        const float radius = obj->ptr->circle.pt == NULL
+                                 ? obj->ptr->circle.radius
+                                 : dist2f(center, pointCoord(obj->ptr->circle.pt));
+        return (AnimationPath){1, center, center, radius};
+    }
+    return (AnimationPath){0, pointCoord(obj->ptr->line.pt1), pointCoord(obj->ptr->line.pt2), 0};
+}
+
+// lines, rays and segments are swept from pt1 to pt2, circles once around counter-clockwise from angle 0
+static Point2f pathPosition(const AnimationPath *path, const int i, const int count) {
+    if (path->circle) {
+        const float angle = 2 * (float) M_PI * (float) i / (float) count;
+        return (Point2f){path->p1.x + path->radius * cosf(angle), path->p1.y + path->radius * sinf(angle)};
+    }
+
+    const float t = count == 1 ? 0.f : (float) i / (float) (count - 1);
+    return (Point2f){path->p1.x + (path->p2.x - path->p1.x) * t, path->p1.y + (path->p2.y - path->p1.y) * t};
+}
+
+static void writeRecord(FILE *out, const int frame, GeomObject **record, const int countRecord) {
+    fprintf(out, "%d", frame);
+    for (int i = 0; i < countRecord; ++i) {
+        const Point2f p = pointCoord(record[i]->ptr->point);
+        fprintf(out, ",%.9g,%.9g", p.x, p.y);
+    }
+    fputc('\n', out);
+}
+
+// animate <point> along <line|circle> steps <n> [record <point>...] [--out <file>] [--render-every <k>]
+int animate(const int argc, const char **argv) {
+    static char summary[64];
+
+    if (argc == 1)
+        return throwError(ERROR_NO_ARG_GIVEN, noArgGiven(*argv));
+    if (argc < 6)
+        return throwError(ERROR_NOT_ENOUGH_ARG, notEnoughArg(*argv));
+
+    const GeomObject *obj = findObject(POINT, argv[1]);
+    if (obj == NULL)
+        return throwError(ERROR_NOT_FOUND_OBJECT, objectNotFound(argv[1]));
+    if (obj->ptr->point->numParents != 0)
+        return throwError(ERROR_INVALID_ARG, invalidArg("point", "Please a free point"));
+
+    if (strhash64(argv[2]) != STR_HASH64('a', 'l', 'o', 'n', 'g', 0, 0, 0))
+        return throwError(ERROR_UNKOWN_ARG, unknownArgs(argv[2]));
+    GeomObject *pathObj = findObject(ANY, argv[3]);
+    if (pathObj == NULL)
+        return throwError(ERROR_NOT_FOUND_OBJECT, objectNotFound(argv[3]));
+    if (pathObj->type == POINT)
+        return throwError(ERROR_INVALID_ARG, invalidArg("path", "Please line/ray/seg/circle"));
+
+    if (strhash64(argv[4]) != STR_HASH64('s', 't', 'e', 'p', 's', 0, 0, 0))
+        return throwError(ERROR_UNKOWN_ARG, unknownArgs(argv[4]));
+    char *end;
+    const int steps = (int) strtol(argv[5], &end, 10);
+    if (*end != '\0' || steps <= 0)
+        return throwError(ERROR_INVALID_ARG, invalidArg("steps", NULL));
+
+    GeomObject **record = malloc(sizeof(GeomObject *) * argc);
+    int countRecord = 0, renderEvery = 0;
+    const char *filename = NULL;
+    for (const char **arg = argv + 6, **endptr = argv + argc; arg != endptr;) {
+        switch (strhash64(*arg)) {
+            case STR_HASH64('r', 'e', 'c', 'o', 'r', 'd', 0, 0):
+                while (++arg != endptr && **arg != '-') {
+                    record[countRecord] = findObject(POINT, *arg);
+                    if (record[countRecord++] == NULL) {
+                        free(record);
+                        return throwError(ERROR_NOT_FOUND_OBJECT, objectNotFound(*arg));
+                    }
+                }
+                break;
+            case STR_HASH64('-', '-', 'o', 'u', 't', 0, 0, 0):
+                if (++arg != endptr)
+                    filename = *arg++;
+                break;
+            case STR_HASH64('-', '-', 'r', 'e', 'n', 'd', 'e', 'r'):
+                // the hash only packs 8 chars, the option is checked in full
+                if (strcmp(*arg, "--render-every") != 0) {
+                    free(record);
+                    return throwError(ERROR_UNKOWN_ARG, unknownArgs(*arg));
+                }
+                if (++arg == endptr)
+                    break;
+                renderEvery = (int) strtol(*arg++, &end, 10);
+                if (*end != '\0' || renderEvery < 0) {
+                    free(record);
+                    return throwError(ERROR_INVALID_ARG, invalidArg("render-every", NULL));
+                }
+                break;
+            default:
+                free(record);
+                return throwError(ERROR_UNKOWN_ARG, unknownArgs(*arg));
+        }
+    }
+
+    FILE *out = stdout;
+    if (filename != NULL && (out = fopen(filename, "w")) == NULL) {
+        free(record);
+        return throwError(ERROR_CANNOT_OPEN_FILE, cannotOpenFileError(filename));
+    }
+    if (countRecord != 0) {
+        fputs("frame", out);
+        for (int i = 0; i < countRecord; ++i)
+            fprintf(out, ",%s.x,%s.y", record[i]->name, record[i]->name);
+        fputc('\n', out);
+    }
+
+    // frames run back to back, nothing is drawn unless asked for
+    const AnimationPath path = getPath(pathObj);
+    PointObject *pt = obj->ptr->point;
+    const Point2f start = pointCoord(pt);
+    const double startTime = getTimeMs();
+    for (int i = 0; i < steps; ++i) {
+        const Point2f dst = pathPosition(&path, i, steps);
+        movePoints(&pt, &dst, 1);
+        if (countRecord != 0)
+            writeRecord(out, i, record, countRecord);
+        if (renderEvery != 0 && i % renderEvery == 0) {
+            markPointsMoved();
+            beginDynamic();
+            presentBoard();
+        }
+    }
+    const double elapsed = getTimeMs() - startTime;
+
+    if (out != stdout)
+        fclose(out);
+    free(record);
+
+    movePoints(&pt, &start, 1);
+    markPointsMoved();
+    endDynamic();
+    refreshBoard();
+
+    snprintf(summary, sizeof(summary), "%d frames in %.1f ms", steps, elapsed);
+    return showMessage(summary);
+}
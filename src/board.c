@@ -1,20 +1,33 @@
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "board.h"
+#include "draw_batch.h"
 #include "geom_errors.h"
 #include "graphical.h"
 #include "object.h"
+#include "spatial_index.h"
 #include "geom_utils.h"
+#include "png_writer.h"
+#include "script_cache.h"
 #include "utils.h"
 
-extern Window *imageWindow;
-extern Point2i origin;
+extern Window *mainWindow, *imageWindow;
+extern Viewport viewport;
 extern GeomObject *pointSet, *lineSet, *circleSet;
 
 static inline float getCircleRadius(CircleObject *cr) {
     if (cr->pt == NULL)
         return cr->radius;
-    return cr->radius = dist2f(cr->center->coord, cr->pt->coord);
+
+    const Point2f center = pointCoord(cr->center), pt = pointCoord(cr->pt);
+    const unsigned version = pointVersion(cr->center) + pointVersion(cr->pt);
+    if (cr->version != version) {
+        cr->radius = dist2f(center, pt);
+        cr->version = version;
+    }
+    return cr->radius;
 }
 
 static inline float sqrdist_lv(const Vector2f line_dir, const Vector2f vec) {
@@ -22,8 +35,8 @@ static inline float sqrdist_lv(const Vector2f line_dir, const Vector2f vec) {
 }
 
 static float sqrdist_lp(const GeomObject *line, const Point2f p) {
-    const Point2f p1 = line->ptr->line.pt1->coord;
-    const Point2f p2 = line->ptr->line.pt2->coord;
+    const Point2f p1 = pointCoord(line->ptr->line.pt1);
+    const Point2f p2 = pointCoord(line->ptr->line.pt2);
     const Vector2f vec1 = vec2_from_2p(p1, p),
             vec2 = vec2_from_2p(p2, p),
             lineDir = vec2_from_2p(p1, p2);
@@ -42,55 +55,620 @@ static float sqrdist_lp(const GeomObject *line, const Point2f p) {
     return A_HUGE_VALF;
 }
 
+#define MAX_DAMAGE_RECTS 8
+#define PICK_RADIUS 5.f // screen pixels
+#define BOUNDS_MARGIN 4 // the most any bounds reach past the object's own extent, in pixels
+#define MIN_SCALE 1e-3f
+#define MAX_SCALE 1e3f
+
+// screen regions that no longer match the scene. past MAX_DAMAGE_RECTS they collapse into one
+static Rect2i damage[MAX_DAMAGE_RECTS];
+static int countDamage = 0, fullDamage = 1;
+
+// objects whose bounds must be recomputed before the next refresh
+static GeomObject **changed = NULL;
+static int countChanged = 0, changedCapacity = 0;
+
+static Window *clipWindow = NULL;
+
+// bumped whenever the viewport moves, screen bounds from an older view describe nothing on screen
+static unsigned viewVersion = 1;
+
+// objects overlapping the rect being repainted, in drawing order
+static GeomObject **visible = NULL;
+static int visibleCapacity = 0;
+
+// while a point is being dragged or animated, everything it does not move is drawn once into
+// staticLayer. a frame then copies the damaged parts back and draws the moving objects over them
+static Window *staticLayer = NULL, *staticClip = NULL;
+static GeomObject **dynamic = NULL;
+static int countDynamic = 0, dynamicCapacity = 0;
+static int layered = 0, staticStale = 0;
+
+// the last refresh that repainted anything, optionally drawn in the top left corner
+static RenderStats frameStats = {0};
+static int statsOverlay = 0;
+
+static RefreshMode refreshMode = REFRESH_IMMEDIATE;
+#define OVERLAY_RECT ((Rect2i){0, 0, 300, 72})
+
+static void damageRect(Rect2i rect) {
+    rect = rect_intersect(rect, (Rect2i){0, 0, imageWindow->width, imageWindow->height});
+    if (fullDamage || rect_empty(rect))
+        return;
+
+    // swallow every rect it touches, the grown rect may touch ones already passed
+    for (int i = 0; i < countDamage;) {
+        if (rect_overlap(rect, damage[i])) {
+            rect = rect_union(rect, damage[i]);
+            damage[i] = damage[--countDamage];
+            i = 0;
+        } else {
+            ++i;
+        }
+    }
+
+    if (countDamage == MAX_DAMAGE_RECTS) {
+        for (int i = 0; i < countDamage; ++i)
+            rect = rect_union(rect, damage[i]);
+        countDamage = 0;
+    }
+    damage[countDamage++] = rect;
+}
+
+void markObjectChanged(GeomObject *obj) {
+    if (obj->flags & OBJECT_CHANGED)
+        return;
+    if (countChanged == changedCapacity)
+        changed = realloc(changed, sizeof(GeomObject *) * (changedCapacity = changedCapacity ? changedCapacity * 2 : 64));
+    obj->flags |= OBJECT_CHANGED;
+    changed[countChanged++] = obj;
+}
+
+static inline Rect2i drawnBounds(const GeomObject *obj) {
+    return obj->boundsView == viewVersion ? obj->bounds : (Rect2i){0};
+}
+
+static inline int drawRank(const GeomObject *obj) {
+    return obj->type == CIRCLE ? 0 : obj->type == POINT ? 2 : 1;
+}
+
+// the order circleSet, lineSet, then pointSet are walked in: newest first within a kind
+static int compareDrawOrder(const void *a, const void *b) {
+    const GeomObject *x = *(GeomObject *const *) a, *y = *(GeomObject *const *) b;
+    if (drawRank(x) != drawRank(y))
+        return drawRank(x) - drawRank(y);
+    return x->serial < y->serial ? 1 : -1;
+}
+
+// every object drawn from a point the last movePoints touched
+void markPointsMoved() {
+    PointObject *const *moved;
+    const int count = getLastMoved(&moved);
+    for (int i = 0; i < count; ++i)
+        for (const ObjectLink *link = moved[i]->users; link != NULL; link = link->next)
+            markObjectChanged(link->obj);
+}
+
+// the objects the last movePoints touched go on the dynamic layer until endDynamic
+void beginDynamic() {
+    if (layered)
+        return;
+
+    PointObject *const *moved;
+    const int count = getLastMoved(&moved);
+    for (int i = 0; i < count; ++i) {
+        for (const ObjectLink *link = moved[i]->users; link != NULL; link = link->next) {
+            if (link->obj->flags & OBJECT_DYNAMIC)
+                continue;
+            if (countDynamic == dynamicCapacity)
+                dynamic = realloc(dynamic, sizeof(GeomObject *) * (dynamicCapacity = dynamicCapacity ? dynamicCapacity * 2 : 64));
+            link->obj->flags |= OBJECT_DYNAMIC;
+            dynamic[countDynamic++] = link->obj;
+        }
+    }
+
+    // the moving objects keep the usual order among themselves
+    if (countDynamic > 1)
+        qsort(dynamic, countDynamic, sizeof(GeomObject *), compareDrawOrder);
+    layered = staticStale = 1;
+}
+
+// drawn on top while layered, the moving objects go back to their usual overlap order
+void endDynamic() {
+    if (!layered)
+        return;
+    for (int i = 0; i < countDynamic; ++i) {
+        dynamic[i]->flags &= ~OBJECT_DYNAMIC;
+        damageRect(drawnBounds(dynamic[i]));
+    }
+    countDynamic = 0;
+    layered = 0;
+}
+
+// the object is about to be freed, leave a hole where it was drawn
+void forgetObject(GeomObject *obj) {
+    if (obj->flags & OBJECT_DYNAMIC)
+        endDynamic();
+    staticStale = 1;
+    damageRect(drawnBounds(obj));
+    spatialIndexRemove(obj);
+    if (!(obj->flags & OBJECT_CHANGED))
+        return;
+    for (int i = 0; i < countChanged; ++i) {
+        if (changed[i] == obj) {
+            changed[i] = changed[--countChanged];
+            break;
+        }
+    }
+}
+
+// the scene was thrown away as a whole
+void resetBoard() {
+    spatialIndexClear();
+    countDynamic = 0;
+    layered = 0;
+    countChanged = 0;
+    countDamage = 0;
+    fullDamage = 1;
+}
+
+#define SCREEN_LIMIT ((float) 0x100000)
+
+// far enough off screen, and far from overflowing once offsets and margins are added. nan lands there too
+static inline float clampScreen(const float v) {
+    return v > -SCREEN_LIMIT ? minf(v, SCREEN_LIMIT) : -SCREEN_LIMIT;
+}
+
+static inline Point2i screenCoord(PointObject *pt) {
+    const Point2f p = pointCoord(pt);
+    return toImageCoord((Point2f){clampScreen(p.x), clampScreen(p.y)}, viewport);
+}
+
+static inline int screenRadius(CircleObject *cr) {
+    const float radius = getCircleRadius(cr) * viewport.scale;
+    return radius > 0.f ? (int) minf(radius, SCREEN_LIMIT) : 0;
+}
+
+static Rect2i pointsBounds(const Point2i p1, const Point2i p2, const int margin) {
+    const int x = p1.x < p2.x ? p1.x : p2.x, y = p1.y < p2.y ? p1.y : p2.y;
+    return (Rect2i){x - margin, y - margin, abs(p1.x - p2.x) + 2 * margin + 1, abs(p1.y - p2.y) + 2 * margin + 1};
+}
+
+#define CLIP_MARGIN 4.f
+
+// Liang-Barsky: cuts the visible part out of pt1 + t (pt2 - pt1), with t over the whole line, t >= 0 for a ray
+// or 0 <= t <= 1 for a segment. the board is grown by CLIP_MARGIN so cut ends never show their caps
+static int clipLine(const GeomObject *line, Point2i *end1, Point2i *end2) {
+    const Point2f p1 = pointCoord(line->ptr->line.pt1), p2 = pointCoord(line->ptr->line.pt2);
+    const Vector2f dir = vec2_from_2p(p1, p2);
+    if (line->type != SEG && dir.x == 0.f && dir.y == 0.f)
+        return 0;
+
+    const Point2f min = toMathCoord((Point2i){0, imageWindow->height}, viewport);
+    const Point2f max = toMathCoord((Point2i){imageWindow->width, 0}, viewport);
+    const float p[4] = {-dir.x, dir.x, -dir.y, dir.y};
+    const float q[4] = {
+        p1.x - (min.x - CLIP_MARGIN), max.x + CLIP_MARGIN - p1.x,
+        p1.y - (min.y - CLIP_MARGIN), max.y + CLIP_MARGIN - p1.y
+    };
+
+    float t0 = line->type == LINE ? -INFINITY : 0.f, t1 = line->type == SEG ? 1.f : INFINITY;
+    for (int i = 0; i < 4; ++i) {
+        if (p[i] == 0.f) {
+            if (q[i] < 0.f)
+                return 0;
+            continue;
+        }
+        const float t = q[i] / p[i];
+        if (p[i] < 0.f)
+            t0 = maxf(t0, t);
+        else
+            t1 = minf(t1, t);
+    }
+    // also false for nan
+    if (!(t0 <= t1))
+        return 0;
+
+    *end1 = toImageCoord((Point2f){p1.x + t0 * dir.x, p1.y + t0 * dir.y}, viewport);
+    *end2 = toImageCoord((Point2f){p1.x + t1 * dir.x, p1.y + t1 * dir.y}, viewport);
+    return 1;
+}
+
+// screen area covered by batchObject, with a pixel to spare for antialiasing
+static Rect2i objectBounds(GeomObject *obj) {
+    Point2i center, end1, end2;
+    int radius;
+    switch (obj->type) {
+        case POINT:
+            center = screenCoord(obj->ptr->point);
+            return pointsBounds(center, center, 4);
+        case CIRCLE:
+            center = screenCoord(obj->ptr->circle.center);
+            radius = screenRadius(&obj->ptr->circle);
+            return pointsBounds(center, center, radius + 2);
+        default:
+            if (!clipLine(obj, &end1, &end2))
+                return (Rect2i){0};
+            return pointsBounds(end1, end2, 2);
+    }
+}
+
+// in math coords, what the pick grid files the object under
+static void mathBounds(GeomObject *obj, Point2f *min, Point2f *max) {
+    Point2f p1, p2;
+    float radius = 0.f;
+    switch (obj->type) {
+        case POINT:
+            p1 = p2 = pointCoord(obj->ptr->point);
+            break;
+        case CIRCLE:
+            p1 = p2 = pointCoord(obj->ptr->circle.center);
+            radius = getCircleRadius(&obj->ptr->circle);
+            break;
+        case SEG:
+            p1 = pointCoord(obj->ptr->line.pt1);
+            p2 = pointCoord(obj->ptr->line.pt2);
+            break;
+        default:
+            *min = (Point2f){-INFINITY, -INFINITY};
+            *max = (Point2f){INFINITY, INFINITY};
+            return;
+    }
+    *min = (Point2f){minf(p1.x, p2.x) - radius, minf(p1.y, p2.y) - radius};
+    *max = (Point2f){maxf(p1.x, p2.x) + radius, maxf(p1.y, p2.y) + radius};
+}
+
+static void updateBounds(GeomObject *obj) {
+    obj->bounds = obj->show ? objectBounds(obj) : (Rect2i){0};
+    obj->boundsView = viewVersion;
+}
+
+// the shown objects overlapping a screen rect, into visible in drawing order. anything off it is
+// never looked at, the pick grid hands out only what lies near. skip drops objects with those flags
+static int collectVisible(const Rect2i rect, const int skip) {
+    const Point2f min = toMathCoord((Point2i){rect.x - BOUNDS_MARGIN, rect.y + rect.height + BOUNDS_MARGIN}, viewport);
+    const Point2f max = toMathCoord((Point2i){rect.x + rect.width + BOUNDS_MARGIN, rect.y - BOUNDS_MARGIN}, viewport);
+    GeomObject *const *candidates;
+    const int countCandidates = spatialIndexQuery(min, max, &candidates);
+    if (visibleCapacity < countCandidates)
+        visible = realloc(visible, sizeof(GeomObject *) * (visibleCapacity = countCandidates));
+
+    // a candidate may come up more than once
+    int count = 0;
+    for (int i = 0; i < countCandidates; ++i) {
+        GeomObject *obj = candidates[i];
+        if (obj->flags & (OBJECT_LISTED | skip))
+            continue;
+        obj->flags |= OBJECT_LISTED;
+        visible[count++] = obj;
+    }
+
+    int kept = 0;
+    for (int i = 0; i < count; ++i) {
+        GeomObject *obj = visible[i];
+        obj->flags &= ~OBJECT_LISTED;
+        if (obj->boundsView != viewVersion)
+            updateBounds(obj);
+        if (obj->show && rect_overlap(obj->bounds, rect))
+            visible[kept++] = obj;
+        else if (obj->show)
+            ++frameStats.culled;
+    }
+
+    if (kept > 1)
+        qsort(visible, kept, sizeof(GeomObject *), compareDrawOrder);
+    return kept;
+}
+
+static DrawBatch batches[BATCH_KIND_COUNT];
+
+// offset is where the window's top left corner sits on the board
+static void batchObject(GeomObject *obj, const Point2i offset) {
+    DrawBatch *batch;
+    Point2i p1, p2;
+    switch (obj->type) {
+        case POINT:
+            batch = batches + BATCH_POINTS;
+            batchReserve(batch, 1);
+            p1 = screenCoord(obj->ptr->point);
+            batch->coords[batch->count] = (Point2i){p1.x - offset.x, p1.y - offset.y};
+            break;
+        case CIRCLE:
+            batch = batches + BATCH_CIRCLES;
+            batchReserve(batch, 1);
+            p1 = screenCoord(obj->ptr->circle.center);
+            batch->coords[batch->count] = (Point2i){p1.x - offset.x, p1.y - offset.y};
+            batch->radii[batch->count] = screenRadius(&obj->ptr->circle);
+            break;
+        default:
+            if (!clipLine(obj, &p1, &p2))
+                return;
+            batch = batches + BATCH_LINES;
+            batchReserve(batch, 2);
+            batch->coords[2 * batch->count] = (Point2i){p1.x - offset.x, p1.y - offset.y};
+            batch->coords[2 * batch->count + 1] = (Point2i){p2.x - offset.x, p2.y - offset.y};
+    }
+    batch->bounds[batch->count] = (Rect2i){obj->bounds.x - offset.x, obj->bounds.y - offset.y,
+                                           obj->bounds.width, obj->bounds.height};
+    batch->colors[batch->count++] = obj->color;
+    ++frameStats.drawn;
+}
+
+static void repaintRect(const Rect2i rect) {
+    if (clipWindow == NULL)
+        clipWindow = getSubWindow(imageWindow, rect.x, rect.y, rect.width, rect.height);
+    else
+        moveSubWindow(clipWindow, imageWindow, rect.x, rect.y, rect.width, rect.height);
+
+    const double start = getTimeMs();
+    windowFill(clipWindow, 255, 255, 255);
+    frameStats.fillMs += getTimeMs() - start;
+
+    const int count = collectVisible(rect, 0);
+    for (int i = 0; i < count; ++i)
+        batchObject(visible[i], (Point2i){rect.x, rect.y});
+    flushBatches(clipWindow, batches);
+}
+
+static void renderStatic() {
+    if (staticLayer == NULL)
+        staticLayer = getNewWindow("static", imageWindow->width, imageWindow->height);
+
+    const double start = getTimeMs();
+    windowFill(staticLayer, 255, 255, 255);
+    frameStats.fillMs += getTimeMs() - start;
+
+    const int count = collectVisible((Rect2i){0, 0, imageWindow->width, imageWindow->height}, OBJECT_DYNAMIC);
+    for (int i = 0; i < count; ++i)
+        batchObject(visible[i], (Point2i){0, 0});
+    flushBatches(staticLayer, batches);
+
+    for (int i = 0; i < countDynamic; ++i)
+        if (dynamic[i]->boundsView != viewVersion)
+            updateBounds(dynamic[i]);
+    staticStale = 0;
+}
+
+static void composeRect(const Rect2i rect) {
+    if (clipWindow == NULL)
+        clipWindow = getSubWindow(imageWindow, rect.x, rect.y, rect.width, rect.height);
+    else
+        moveSubWindow(clipWindow, imageWindow, rect.x, rect.y, rect.width, rect.height);
+    if (staticClip == NULL)
+        staticClip = getSubWindow(staticLayer, rect.x, rect.y, rect.width, rect.height);
+    else
+        moveSubWindow(staticClip, staticLayer, rect.x, rect.y, rect.width, rect.height);
+
+    const double start = getTimeMs();
+    windowCopy(clipWindow, staticClip);
+    frameStats.fillMs += getTimeMs() - start;
+
+    for (int i = 0; i < countDynamic; ++i) {
+        if (!dynamic[i]->show)
+            continue;
+        if (rect_overlap(dynamic[i]->bounds, rect))
+            batchObject(dynamic[i], (Point2i){rect.x, rect.y});
+        else
+            ++frameStats.culled;
+    }
+    flushBatches(clipWindow, batches);
+}
+
+// brings screen bounds, damage and the pick grid up to date with the changed objects
+static void flushChanged() {
+    Point2f min, max;
+    for (int i = 0; i < countChanged; ++i) {
+        GeomObject *obj = changed[i];
+        obj->flags &= ~OBJECT_CHANGED;
+        if (!(obj->flags & OBJECT_DYNAMIC))
+            staticStale = 1;
+        damageRect(drawnBounds(obj));
+        updateBounds(obj);
+        damageRect(obj->bounds);
+
+        if (obj->show) {
+            mathBounds(obj, &min, &max);
+            spatialIndexUpdate(obj, min, max);
+        } else {
+            spatialIndexRemove(obj);
+        }
+    }
+    countChanged = 0;
+}
+
+static void repaintDamage() {
+    if (layered) {
+        if (staticStale || fullDamage) {
+            if (staticStale)
+                renderStatic();
+            composeRect((Rect2i){0, 0, imageWindow->width, imageWindow->height});
+        } else {
+            for (int i = 0; i < countDamage; ++i)
+                composeRect(damage[i]);
+        }
+        return;
+    }
+
+    // past half the board, one pass over everything on screen costs less than one per rect
+    int area = 0;
+    for (int i = 0; i < countDamage; ++i)
+        area += damage[i].width * damage[i].height;
+    if (fullDamage || 2 * area > imageWindow->width * imageWindow->height) {
+        repaintRect((Rect2i){0, 0, imageWindow->width, imageWindow->height});
+    } else {
+        for (int i = 0; i < countDamage; ++i)
+            repaintRect(damage[i]);
+    }
+}
+
+static void drawOverlay() {
+    char text[96];
+    drawRect(imageWindow, (Point2i){OVERLAY_RECT.x, OVERLAY_RECT.y}, OVERLAY_RECT.width, OVERLAY_RECT.height,
+             0xf0f0f0, -1);
+
+    snprintf(text, sizeof(text), "frame %.2f ms  fill %.2f ms", frameStats.frameMs, frameStats.fillMs);
+    drawText(imageWindow, text, (Point2i){6, 16}, 0x0e0e0e, 10);
+    snprintf(text, sizeof(text), "circles %.2f  lines %.2f  points %.2f ms", frameStats.circleMs,
+             frameStats.lineMs, frameStats.pointMs);
+    drawText(imageWindow, text, (Point2i){6, 32}, 0x0e0e0e, 10);
+    snprintf(text, sizeof(text), "drawn %d  culled %d", frameStats.drawn, frameStats.culled);
+    drawText(imageWindow, text, (Point2i){6, 48}, 0x0e0e0e, 10);
+    snprintf(text, sizeof(text), "propagation %.3f ms", frameStats.propagationMs);
+    drawText(imageWindow, text, (Point2i){6, 64}, 0x0e0e0e, 10);
+}
+
+// only the damaged parts of the board are cleared and drawn again
+void forceRefresh() {
+    flushChanged();
+
+    // the numbers change every frame, so the overlay always needs its area back
+    if (statsOverlay)
+        damageRect(OVERLAY_RECT);
+    if (!fullDamage && countDamage == 0 && !(layered && staticStale))
+        return;
+
+    double passMs[BATCH_KIND_COUNT];
+    takeBatchTimes(passMs);
+    frameStats = (RenderStats){0};
+    const double start = getTimeMs();
+
+    repaintDamage();
+    countDamage = 0;
+    fullDamage = 0;
+
+    takeBatchTimes(passMs);
+    frameStats.frameMs = getTimeMs() - start;
+    frameStats.circleMs = passMs[BATCH_CIRCLES];
+    frameStats.lineMs = passMs[BATCH_LINES];
+    frameStats.pointMs = passMs[BATCH_POINTS];
+    frameStats.propagationMs = getLastMoveMs();
+
+    if (statsOverlay)
+        drawOverlay();
+}
+
 void refreshBoard() {
-    windowFill(imageWindow, 255, 255, 255);
+    if (refreshMode == REFRESH_IMMEDIATE)
+        forceRefresh();
+}
 
-    for (GeomObject *cr = circleSet; cr != NULL; cr = cr->next)
-        if (cr->show)
-            drawCircle(imageWindow, toImageCoord(cr->ptr->circle.center->coord, origin),
-                       (int) getCircleRadius(&cr->ptr->circle), cr->color, 2);
+RefreshMode setRefreshMode(const RefreshMode mode) {
+    const RefreshMode previous = refreshMode;
+    refreshMode = mode;
+    return previous;
+}
 
-    for (const GeomObject *ln = lineSet; ln != NULL; ln = ln->next)
-        if (ln->show)
-            drawLine(imageWindow, toImageCoord(ln->ptr->line.showPt1->coord, origin),
-                     toImageCoord(ln->ptr->line.showPt2->coord, origin), ln->color, 2);
+const RenderStats *getRenderStats() {
+    return &frameStats;
+}
 
-    for (const GeomObject *pt = pointSet; pt != NULL; pt = pt->next)
-        if (pt->show)
-            drawPoint(imageWindow, toImageCoord(pt->ptr->point->coord, origin), pt->color);
+void setStatsOverlay(const int on) {
+    statsOverlay = on;
+    invalidateBoard();
 }
 
-GeomObject *mouseSelect(const int x, const int y) {
-    const Point2f mouse = toMathCoord((Point2i){x, y}, origin);
-    const float threshold = 25.f;
+void invalidateBoard() {
+    fullDamage = 1;
+}
 
-    for (GeomObject *pt = pointSet; pt != NULL; pt = pt->next)
-        if (pt->show && sqrdist(mouse, pt->ptr->point->coord) < threshold)
-            return pt;
+static void viewportChanged() {
+    ++viewVersion;
+    fullDamage = staticStale = 1;
+}
+
+// the math point under (x, y) stays where it is. a factor past the limits stops at them, several wheel
+// notches come in as one factor
+void zoomBoard(const int x, const int y, const float factor) {
+    float scale = viewport.scale * factor;
+    if (scale < MIN_SCALE)
+        scale = MIN_SCALE;
+    else if (scale > MAX_SCALE)
+        scale = MAX_SCALE;
+    if (!(scale != viewport.scale && scale >= MIN_SCALE))
+        return;
+
+    const Point2f anchor = toMathCoord((Point2i){x, y}, viewport);
+    viewport.scale = scale;
+    viewport.origin = (Point2f){(float) x - anchor.x * scale, (float) y + anchor.y * scale};
+    viewportChanged();
+}
+
+void panBoard(const Point2f origin) {
+    viewport.origin = origin;
+    viewportChanged();
+}
 
-    for (GeomObject *ln = lineSet; ln != NULL; ln = ln->next)
-        if (ln->show && sqrdist_lp(ln, mouse) < threshold)
-            return ln;
+// redraw and put it on screen right away, for callers that are not going back to the console loop
+void presentBoard() {
+    if (refreshMode == REFRESH_DISABLED)
+        return;
+    forceRefresh();
+    showWindow(mainWindow);
+    waitKey(1);
+}
 
-    for (GeomObject *cr = circleSet; cr != NULL; cr = cr->next)
-        if (cr->show && dist2f(mouse, cr->ptr->circle.center->coord) - cr->ptr->circle.radius < 5.f)
-            return cr;
+// a script's way to show what it has built so far
+int refresh(const int argc, const char **argv) {
+    presentBoard();
+    recordRefresh();
+    return 0;
+}
 
-    return NULL;
+static inline int pickRank(const GeomObject *obj) {
+    return obj->type == POINT ? 0 : obj->type == CIRCLE ? 2 : 1;
+}
+
+static int pickHit(GeomObject *obj, const Point2f mouse, const float radius) {
+    switch (obj->type) {
+        case POINT:
+            return sqrdist(mouse, pointCoord(obj->ptr->point)) < radius * radius;
+        case CIRCLE:
+            return dist2f(mouse, pointCoord(obj->ptr->circle.center)) - getCircleRadius(&obj->ptr->circle) < radius;
+        default:
+            return sqrdist_lp(obj, mouse) < radius * radius;
+    }
+}
+
+// points before lines before circles, and the newest one within a kind.
+// only objects filed near the mouse are tested
+GeomObject *mouseSelect(const int x, const int y) {
+    flushChanged();
+
+    const Point2f mouse = toMathCoord((Point2i){x, y}, viewport);
+    const float radius = PICK_RADIUS / viewport.scale;
+    GeomObject *const *candidates;
+    const int count = spatialIndexQuery((Point2f){mouse.x - radius, mouse.y - radius},
+                                        (Point2f){mouse.x + radius, mouse.y + radius}, &candidates);
+
+    GeomObject *best = NULL;
+    int bestRank = 3;
+    for (int i = 0; i < count; ++i) {
+        GeomObject *obj = candidates[i];
+        const int rank = pickRank(obj);
+        if (rank > bestRank || (rank == bestRank && obj->serial <= best->serial))
+            continue;
+        if (obj->show && pickHit(obj, mouse, radius)) {
+            best = obj;
+            bestRank = rank;
+        }
+    }
+    return best;
 }
 
 int show(const int argc, const char **argv) {
     if (argc == 1)
         return throwError(ERROR_NO_ARG_GIVEN, noArgGiven(*argv));
 
-    const unsigned long long id = strhash64(argv[1]);
-    GeomObject *obj = findObject(ANY, id);
+    GeomObject *obj = findObject(ANY, argv[1]);
 
     if (obj == NULL)
         return throwError(ERROR_NOT_FOUND_OBJECT, objectNotFound(argv[1]));
 
     if (argc == 2) {
         obj->show = 1;
+        markObjectChanged(obj);
+        recordShow(obj);
         refreshBoard();
         return 0;
     }
@@ -102,6 +680,8 @@ int show(const int argc, const char **argv) {
 
     obj->show = 1;
     obj->color = color;
+    markObjectChanged(obj);
+    recordShow(obj);
     refreshBoard();
     return 0;
 }
@@ -110,13 +690,93 @@ int hide(const int argc, const char **argv) {
     if (argc == 1)
         return throwError(ERROR_NO_ARG_GIVEN, noArgGiven(*argv));
 
-    const uint64_t id = strhash64(argv[1]);
-    GeomObject *obj = findObject(ANY, id);
+    GeomObject *obj = findObject(ANY, argv[1]);
 
     if (obj == NULL)
         return throwError(ERROR_NOT_FOUND_OBJECT, objectNotFound(argv[1]));
 
     obj->show = 0;
+    markObjectChanged(obj);
+    recordShow(obj);
     refreshBoard();
     return 0;
 }
+
+static void svgObject(FILE *file, GeomObject *obj) {
+    Point2i p1, p2;
+    switch (obj->type) {
+        case POINT:
+            p1 = screenCoord(obj->ptr->point);
+            fprintf(file, "<circle cx=\"%d\" cy=\"%d\" r=\"3\" fill=\"#%06x\"/>\n", p1.x, p1.y, obj->color);
+            return;
+        case CIRCLE:
+            p1 = screenCoord(obj->ptr->circle.center);
+            fprintf(file, "<circle cx=\"%d\" cy=\"%d\" r=\"%d\" fill=\"none\" stroke=\"#%06x\" stroke-width=\"2\"/>\n",
+                    p1.x, p1.y, screenRadius(&obj->ptr->circle), obj->color);
+            return;
+        default:
+            if (!clipLine(obj, &p1, &p2))
+                return;
+            fprintf(file, "<line x1=\"%d\" y1=\"%d\" x2=\"%d\" y2=\"%d\" stroke=\"#%06x\" stroke-width=\"2\" "
+                    "stroke-linecap=\"round\"/>\n", p1.x, p1.y, p2.x, p2.y, obj->color);
+    }
+}
+
+// the board as vectors, same view and overlap order as the raster. needs nothing drawn, so it works
+// with rendering off
+static int writeSvg(const char *filename) {
+    FILE *file = fopen(filename, "w");
+    if (file == NULL)
+        return -1;
+
+    const int width = imageWindow->width, height = imageWindow->height;
+    fprintf(file, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" viewBox=\"0 0 %d %d\">\n",
+            width, height, width, height);
+    fprintf(file, "<rect width=\"100%%\" height=\"100%%\" fill=\"#ffffff\"/>\n");
+    GeomObject *sets[3] = {circleSet, lineSet, pointSet};
+    for (int i = 0; i < 3; ++i)
+        for (GeomObject *obj = sets[i]; obj != NULL; obj = obj->next)
+            if (obj->show)
+                svgObject(file, obj);
+    fprintf(file, "</svg>\n");
+
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+static inline int hasExtension(const char *filename, const char *extension) {
+    const size_t length = strlen(filename), extensionLength = strlen(extension);
+    return length >= extensionLength && strcmp(filename + length - extensionLength, extension) == 0;
+}
+
+// repaints the whole board and writes it out, the repaint time goes into the message.
+// a .svg name gets vectors instead
+int render(const int argc, const char **argv) {
+    static char summary[64];
+
+    if (argc == 1)
+        return throwError(ERROR_NO_ARG_GIVEN, noArgGiven(*argv));
+
+    if (hasExtension(argv[1], ".svg")) {
+        if (writeSvg(argv[1]) != 0)
+            return throwError(ERROR_CANNOT_OPEN_FILE, cannotOpenFileError(argv[1]));
+        return 0;
+    }
+    if (refreshMode == REFRESH_DISABLED)
+        return throwError(ERROR_INVALID_ARG, invalidArg("render", "Rendering is off, only .svg can be written"));
+
+    invalidateBoard();
+    const double start = getTimeMs();
+    forceRefresh();
+    const double elapsed = getTimeMs() - start;
+
+    const int width = imageWindow->width, height = imageWindow->height;
+    unsigned char *rgb = malloc((size_t) width * height * 3);
+    windowRead(imageWindow, rgb);
+    const int error = writePng(argv[1], rgb, width, height);
+    free(rgb);
+    if (error != 0)
+        return throwError(ERROR_CANNOT_OPEN_FILE, cannotOpenFileError(argv[1]));
+
+    snprintf(summary, sizeof(summary), "%dx%d in %.2f ms", width, height, elapsed);
+    return showMessage(summary);
+}
@@ -3,22 +3,55 @@
 #include "graphical.h"
 #include "board.h"
 #include "file_manage.h"
+#include "point_import.h"
+#include "stats.h"
+#include "animate.h"
+#include "geom_utils.h"
 #include "utils.h"
 
 #include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#define FRAME_INTERVAL_MS 16
+#define ZOOM_STEP 1.25f
+
 extern Window *mainWindow, *consoleWindow;
+extern Viewport viewport;
 extern int errorType;
-extern const char *errorText;
+extern const char *errorText, *messageText;
 
 static char strCmdLine[256] = {0};
 static int cursor = 0;
 
+// the mouse callback only remembers where a dragged point (or the board, when panning) should go,
+// and how far the wheel has zoomed. the console loop applies both once per frame, so a burst of move
+// or wheel events costs one redraw
+typedef struct {
+    int pressed, dragging, pending;
+    Point2i down, target;
+    PointHandle point;
+    int panning;
+    Point2f startOrigin;
+} DragState;
+
+typedef struct {
+    float factor; // 1 when nothing is pending
+    Point2i at;
+} ZoomState;
+
+static DragState drag = {0};
+static ZoomState zoom = {1.f, {0, 0}};
+
+static void flushDrag();
+
 static void refreshConsole() {
     windowFill(consoleWindow, 0x88, 0x88, 0x88);
     if (strCmdLine[0] != '\0')
         drawText(consoleWindow, strCmdLine, (Point2i){10, 30}, 0x0e0e0e, 15);
+    if (messageText != NULL)
+        drawText(consoleWindow, messageText, (Point2i){10, 60}, 0x0e0e0e, 15);
     if (errorText != NULL)
         drawText(consoleWindow, errorText, (Point2i){10, 90}, 0xff0000, 15);
     showWindow(mainWindow);
@@ -28,17 +61,23 @@ static char *consoleGetLine() {
     static char buffer[256];
 
     while (1) {
-        const char c = waitKey(0);
+        const char c = waitKey(FRAME_INTERVAL_MS);
         // 鼠标回调
         while (strCmdLine[cursor] != 0)
             ++cursor;
 
+        if (c == -1) {
+#ifdef _WIN32
+            if (!windowVisible(mainWindow)) // 点击窗口叉叉（只有windows有效）
+                return NULL;
+#endif
+            flushDrag();
+            continue;
+        }
+
         switch (c) {
             case 27: // ESC
                 destroyWindow(mainWindow);
-#ifdef _WIN32
-            case -1: // 点击窗口叉叉（只有windows有效）
-#endif
                 return NULL;
 #ifdef __APPLE__
             case 127: // delete
@@ -60,10 +99,13 @@ static char *consoleGetLine() {
 }
 
 static inline void pushback(const char *src) {
-    memcpy(strCmdLine + cursor, src, 8);
+    strncpy(strCmdLine + cursor, src, sizeof(strCmdLine) - 1 - cursor);
 }
 
-static int splitArgs(char *buffer, const char **argv) {
+// words are cut out in place, argv grows with them
+static int splitArgs(char *buffer, const char ***argv) {
+    static const char **words = NULL;
+    static int capacity = 0;
     int argc = 0;
     int isOneWord = 1;
     while (1) {
@@ -71,6 +113,7 @@ static int splitArgs(char *buffer, const char **argv) {
             case '\n':
                 *buffer = 0;
             case '\0':
+                *argv = words;
                 return argc;
             case ' ':
                 *buffer++ = 0;
@@ -78,19 +121,23 @@ static int splitArgs(char *buffer, const char **argv) {
                 break;
             default:
                 if (isOneWord) {
-                    argv[argc++] = buffer;
+                    if (argc == capacity)
+                        words = realloc(words, sizeof(char *) * (capacity = capacity ? capacity * 2 : 16));
+                    words[argc++] = buffer;
                     isOneWord = 0;
                 }
                 ++buffer;
         }
-        if (argc == 16)
-            return argc;
     }
 }
 
 int processCommand(char *buffer) {
-    static const char *argv[16];
-    const int argc = splitArgs(buffer, argv);
+    const char **argv;
+    const int argc = splitArgs(buffer, &argv);
+    return executeCommand(argc, argv);
+}
+
+int executeCommand(const int argc, const char **argv) {
     if (argc == 0) return 0;
 
     resetError();
@@ -103,24 +150,133 @@ int processCommand(char *buffer) {
             return hide(argc, argv);
         case STR_HASH64('l', 'o', 'a', 'd', '-', 's', 'r', 'c'):
             return load_src(argc, argv);
+        // the hash only packs 8 chars, longer names are checked in full
+        case STR_HASH64('s', 'a', 'v', 'e', '-', 's', 'c', 'e'):
+            if (strcmp(argv[0], "save-scene") == 0)
+                return save_scene(argc, argv);
+            break;
+        case STR_HASH64('l', 'o', 'a', 'd', '-', 's', 'c', 'e'):
+            if (strcmp(argv[0], "load-scene") == 0)
+                return load_scene(argc, argv);
+            break;
+        case STR_HASH64('i', 'm', 'p', 'o', 'r', 't', '-', 'p'):
+            if (strcmp(argv[0], "import-points") == 0)
+                return import_points(argc, argv);
+            break;
         case STR_HASH64('m', 'i', 'd', 'p', 'o', 'i', 'n', 't'):
             return midpoint(argc, argv);
         case STR_HASH64('m', 'o', 'v', 'e', '-', 'p', 't', 0):
             return move_pt(argc, argv);
+        case STR_HASH64('l', 'a', 'z', 'y', 0, 0, 0, 0):
+            return lazy_eval(argc, argv);
+        case STR_HASH64('a', 'n', 'i', 'm', 'a', 't', 'e', 0):
+            return animate(argc, argv);
+        case STR_HASH64('t', 'h', 'r', 'e', 'a', 'd', 's', 0):
+            return set_threads(argc, argv);
+        case STR_HASH64('d', 'e', 'l', 'e', 't', 'e', 0, 0):
+            return delete_object(argc, argv);
+        case STR_HASH64('c', 'l', 'e', 'a', 'r', 0, 0, 0):
+            return clear(argc, argv);
+        case STR_HASH64('s', 't', 'a', 't', 's', 0, 0, 0):
+            return stats(argc, argv);
+        case STR_HASH64('b', 'e', 'n', 'c', 'h', 0, 0, 0):
+            return bench(argc, argv);
+        case STR_HASH64('r', 'e', 'n', 'd', 'e', 'r', 0, 0):
+            return render(argc, argv);
+        case STR_HASH64('r', 'e', 'f', 'r', 'e', 's', 'h', 0):
+            return refresh(argc, argv);
         default:
-            return throwError(ERROR_UNKOWN_COMMAND, unknownCommand(argv[0]));
+            break;
     }
+    return throwError(ERROR_UNKOWN_COMMAND, unknownCommand(argv[0]));
 }
 
+static void flushDrag() {
+    const int zooming = zoom.factor != 1.f;
+    if (!drag.pending && !zooming)
+        return;
+
+    if (drag.pending && drag.panning) {
+        panBoard((Point2f){drag.startOrigin.x + (float) (drag.target.x - drag.down.x),
+                           drag.startOrigin.y + (float) (drag.target.y - drag.down.y)});
+    } else if (drag.pending) {
+        // the point may have been deleted from the console mid-drag
+        PointObject *pt = resolvePointHandle(drag.point);
+        if (pt == NULL) {
+            drag.pressed = drag.dragging = 0;
+            endDynamic();
+        } else {
+            const Point2f dst = toMathCoord(drag.target, viewport);
+            movePoints(&pt, &dst, 1);
+            markPointsMoved();
+            beginDynamic();
+        }
+    }
+    drag.pending = 0;
+
+    if (zooming) {
+        zoomBoard(zoom.at.x, zoom.at.y, zoom.factor);
+        zoom.factor = 1.f;
+        // a pan goes on from the zoomed board, not from the origin it was grabbed at
+        if (drag.pressed && drag.panning) {
+            drag.startOrigin = viewport.origin;
+            drag.down = drag.target;
+        }
+    }
+    refreshBoard();
+    showWindow(mainWindow);
+}
+
+static void pasteSelected(const int x, const int y) {
+    const GeomObject *obj = mouseSelect(x, y);
+    if (obj == NULL)
+        return;
+    pushback(obj->name);
+    refreshConsole();
+}
+
+// a click pastes the object's name, pressing on a free point and moving drags it,
+// pressing on empty space and moving pans. the wheel zooms around the cursor
 static void mouseCallback(const int event, const int x, const int y, const int flags, void *userdata) {
     const GeomObject *obj;
     switch (event) {
         case EVENT_LBUTTONDOWN:
             obj = mouseSelect(x, y);
-            if (obj == NULL)
+            if (obj == NULL) {
+                drag = (DragState){1, 0, 0, {x, y}, {x, y}, {0}, 1, viewport.origin};
+                return;
+            }
+            if (obj->type != POINT || obj->ptr->point->numParents != 0) {
+                pushback(obj->name);
+                refreshConsole();
+                return;
+            }
+            drag = (DragState){1, 0, 0, {x, y}, {x, y}, getPointHandle(obj->ptr->point), 0, {0, 0}};
+            return;
+        case EVENT_MOUSEWHEEL:
+            zoom.factor *= mouseWheelDelta(flags) > 0 ? ZOOM_STEP : 1.f / ZOOM_STEP;
+            zoom.at = (Point2i){x, y};
+            return;
+        case EVENT_MOUSEMOVE:
+            if (!drag.pressed)
+                return;
+            if (!drag.dragging && abs(x - drag.down.x) + abs(y - drag.down.y) < 3)
                 return;
-            pushback((char *) &obj->id);
-            refreshConsole();
+            drag.dragging = drag.pending = 1;
+            drag.target = (Point2i){x, y};
+            return;
+        case EVENT_LBUTTONUP:
+            if (!drag.pressed)
+                return;
+            if (drag.dragging) {
+                flushDrag();
+                endDynamic();
+                refreshBoard();
+                showWindow(mainWindow);
+            } else {
+                pasteSelected(x, y);
+            }
+            drag.pressed = drag.dragging = 0;
         default:
             break;
     }
@@ -145,3 +301,15 @@ void console() {
         refreshConsole();
     }
 }
+
+// no window to type into, commands come from stdin and results go to stdout
+void textConsole() {
+    char line[256];
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (processCommand(line) != 0)
+            fprintf(stderr, "%s\n", errorText);
+        else if (messageText != NULL)
+            printf("%s\n", messageText);
+    }
+}
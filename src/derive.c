@@ -0,0 +1,172 @@
+#include "derive.h"
+#include "geom_utils.h"
+
+#include <stdlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// the kernels are written once against these, lane count depends on what the target has.
+// only add/mul are used, both exactly rounded, so every width matches the scalar code bit for bit
+#if defined(__AVX__)
+#include <immintrin.h>
+#define LANES 8
+typedef __m256 vfloat;
+#define vset1 _mm256_set1_ps
+#define vadd _mm256_add_ps
+#define vmul _mm256_mul_ps
+static inline vfloat vgather(const float *base, const int *idx) {
+    return _mm256_setr_ps(base[idx[0]], base[idx[1]], base[idx[2]], base[idx[3]],
+                          base[idx[4]], base[idx[5]], base[idx[6]], base[idx[7]]);
+}
+static inline void vscatter(float *base, const int *idx, const vfloat v) {
+    float lanes[LANES];
+    _mm256_storeu_ps(lanes, v);
+    for (int i = 0; i < LANES; ++i)
+        base[idx[i]] = lanes[i];
+}
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LANES 4
+typedef __m128 vfloat;
+#define vset1 _mm_set1_ps
+#define vadd _mm_add_ps
+#define vmul _mm_mul_ps
+static inline vfloat vgather(const float *base, const int *idx) {
+    return _mm_setr_ps(base[idx[0]], base[idx[1]], base[idx[2]], base[idx[3]]);
+}
+static inline void vscatter(float *base, const int *idx, const vfloat v) {
+    float lanes[LANES];
+    _mm_storeu_ps(lanes, v);
+    for (int i = 0; i < LANES; ++i)
+        base[idx[i]] = lanes[i];
+}
+#else
+#define LANES 1
+typedef float vfloat;
+#define vset1(a) (a)
+#define vadd(a, b) ((a) + (b))
+#define vmul(a, b) ((a) * (b))
+static inline vfloat vgather(const float *base, const int *idx) {
+    return base[*idx];
+}
+static inline void vscatter(float *base, const int *idx, const vfloat v) {
+    base[*idx] = v;
+}
+#endif
+
+// a batch is split into chunks of this many points between the threads
+#define TAPE_CHUNK 256
+
+Point2f deriveCoord(const DeriveOp op, PointObject *const *parents) {
+    switch (op) {
+        case DERIVE_MIDPOINT:
+            return midpt(pointCoord(parents[0]), pointCoord(parents[1]));
+        default:
+            return pointCoord(*parents);
+    }
+}
+
+static void midpointKernel(const DeriveTape *tape, int i, const int end) {
+    float *x = pointCoords.x, *y = pointCoords.y;
+    const int *dst = tape->dst, *a = tape->src[0], *b = tape->src[1];
+    const vfloat half = vset1(0.5f);
+
+    // (a + b) * 0.5 is exactly (a + b) / 2
+    for (; i + LANES <= end; i += LANES) {
+        vscatter(x, dst + i, vmul(vadd(vgather(x, a + i), vgather(x, b + i)), half));
+        vscatter(y, dst + i, vmul(vadd(vgather(y, a + i), vgather(y, b + i)), half));
+    }
+    for (; i < end; ++i) {
+        x[dst[i]] = (x[a[i]] + x[b[i]]) / 2;
+        y[dst[i]] = (y[a[i]] + y[b[i]]) / 2;
+    }
+}
+
+static void runBatch(const DeriveTape *tape, const DeriveOp op, const int begin, const int end) {
+    switch (op) {
+        case DERIVE_MIDPOINT:
+            midpointKernel(tape, begin, end);
+            break;
+        default:
+            break;
+    }
+
+    for (int i = begin; i < end; ++i)
+        pointCoords.version[tape->dst[i]]++;
+}
+
+static void *grow(void *array, int *capacity, const int size, const size_t elemSize) {
+    if (*capacity >= size)
+        return array;
+    *capacity = size;
+    return realloc(array, elemSize * size);
+}
+
+void buildTape(DeriveTape *tape, PointObject *const *order, const int *levelStart, const int levels) {
+    const int length = levelStart[levels];
+    if (tape->capacity < length) {
+        tape->capacity = length;
+        tape->dst = realloc(tape->dst, sizeof(int) * length);
+        for (int j = 0; j < MAX_PARENTS; ++j)
+            tape->src[j] = realloc(tape->src[j], sizeof(int) * length);
+    }
+    tape->batches = grow(tape->batches, &tape->batchCapacity, levels * (DERIVE_OP_COUNT - 1), sizeof(TapeBatch));
+    tape->levelBatches = grow(tape->levelBatches, &tape->levelCapacity, levels + 1, sizeof(int));
+
+    tape->length = 0;
+    tape->countBatches = 0;
+    tape->levels = levels;
+    for (int level = 0; level < levels; ++level) {
+        tape->levelBatches[level] = tape->countBatches;
+        for (DeriveOp op = DERIVE_NONE + 1; op < DERIVE_OP_COUNT; ++op) {
+            const int start = tape->length;
+            for (int i = levelStart[level]; i < levelStart[level + 1]; ++i) {
+                const PointObject *pt = order[i];
+                if (pt->op != op)
+                    continue;
+                tape->dst[tape->length] = pt->index;
+                for (int j = 0; j < pt->numParents; ++j)
+                    tape->src[j][tape->length] = pt->parents[j]->index;
+                ++tape->length;
+            }
+            if (tape->length != start)
+                tape->batches[tape->countBatches++] = (TapeBatch){op, start, tape->length - start};
+        }
+    }
+    tape->levelBatches[levels] = tape->countBatches;
+}
+
+void runTape(const DeriveTape *tape, const int threads) {
+    if (tape->length < PARALLEL_MIN_POINTS || threads == 1) {
+        for (int i = 0; i < tape->countBatches; ++i) {
+            const TapeBatch *batch = tape->batches + i;
+            runBatch(tape, batch->op, batch->start, batch->start + batch->count);
+        }
+        return;
+    }
+
+    // batches of one level are independent of each other, the barrier only comes between levels
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads > 0 ? threads : omp_get_max_threads())
+#endif
+    for (int level = 0; level < tape->levels; ++level) {
+        for (int i = tape->levelBatches[level]; i < tape->levelBatches[level + 1]; ++i) {
+            const TapeBatch *batch = tape->batches + i;
+            const int chunks = (batch->count + TAPE_CHUNK - 1) / TAPE_CHUNK;
+#ifdef _OPENMP
+#pragma omp for schedule(static) nowait
+#endif
+            for (int chunk = 0; chunk < chunks; ++chunk) {
+                const int begin = batch->start + chunk * TAPE_CHUNK;
+                const int end = begin + TAPE_CHUNK < batch->start + batch->count
+                                    ? begin + TAPE_CHUNK
+                                    : batch->start + batch->count;
+                runBatch(tape, batch->op, begin, end);
+            }
+        }
+#ifdef _OPENMP
+#pragma omp barrier
+#endif
+    }
+}
@@ -0,0 +1,272 @@
+#include "draw_batch.h"
+#include "geom_utils.h"
+#include "utils.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define LINE_THICKNESS 2
+#define TILE_SIZE 128
+#define MIN_TILED_ITEMS 256 // below this, binning costs more than the threads win back
+
+static int rasterThreads = 0;
+
+// per kind, since the last takeBatchTimes
+static double passMs[BATCH_KIND_COUNT];
+
+// one per thread: a sub-window onto the tile being drawn and the tile's items, moved to its corner
+typedef struct {
+    Window *tile;
+    DrawBatch batches[BATCH_KIND_COUNT];
+    double passMs[BATCH_KIND_COUNT];
+} TileWorker;
+
+static TileWorker *workers = NULL;
+static int countWorkers = 0;
+
+// the items of kind k that touch tile t are binItems[k][binStart[k * (tiles + 1) + t] ...
+// binStart[k * (tiles + 1) + t + 1]), in batch order
+static int *binStart = NULL, *binFill = NULL;
+static int binStartCapacity = 0;
+static int *binItems[BATCH_KIND_COUNT];
+static int binItemsCapacity[BATCH_KIND_COUNT];
+static int *itemTiles = NULL, itemTilesCapacity = 0;
+
+// per tile, the drawing order number of the first item that reaches over its edge, INT_MAX if none
+static int *firstCrossing = NULL;
+
+// what the tiles left over, drawn on the whole window once they are done
+static DrawBatch deferred[BATCH_KIND_COUNT];
+
+static inline int coordsPerItem(const int kind) {
+    return kind == BATCH_LINES ? 2 : 1;
+}
+
+void batchReserve(DrawBatch *batch, const int coordsPerItem) {
+    if (batch->count < batch->capacity)
+        return;
+    batch->capacity = batch->capacity ? batch->capacity * 2 : 256;
+    batch->coords = realloc(batch->coords, sizeof(Point2i) * coordsPerItem * batch->capacity);
+    batch->radii = realloc(batch->radii, sizeof(int) * batch->capacity);
+    batch->colors = realloc(batch->colors, sizeof(int) * batch->capacity);
+    batch->bounds = realloc(batch->bounds, sizeof(Rect2i) * batch->capacity);
+}
+
+// ms gets the time of each pass added
+static void drawBatches(const Window *window, const DrawBatch *batches, double *ms) {
+    const DrawBatch *circles = batches + BATCH_CIRCLES, *lines = batches + BATCH_LINES, *points = batches + BATCH_POINTS;
+    const double start = getTimeMs();
+    drawCircleBatch(window, circles->coords, circles->radii, circles->colors, circles->count, LINE_THICKNESS);
+    const double circlesDone = getTimeMs();
+    drawLineBatch(window, lines->coords, lines->colors, lines->count, LINE_THICKNESS);
+    const double linesDone = getTimeMs();
+    drawPointBatch(window, points->coords, points->colors, points->count);
+
+    ms[BATCH_CIRCLES] += circlesDone - start;
+    ms[BATCH_LINES] += linesDone - circlesDone;
+    ms[BATCH_POINTS] += getTimeMs() - linesDone;
+}
+
+#define ITEM_OFF_WINDOW (-1)
+#define ITEM_CROSSING (-2)
+
+// the one tile an item lies in. an item reaching over a tile edge would be clipped there and come out
+// different from the one-pass drawing, so it is ITEM_CROSSING and gets drawn on the whole window
+static int itemTile(const Rect2i bounds, const int width, const int height, const int columns) {
+    const Rect2i visible = rect_intersect(bounds, (Rect2i){0, 0, width, height});
+    if (rect_empty(visible))
+        return ITEM_OFF_WINDOW;
+    if (visible.width != bounds.width || visible.height != bounds.height)
+        return ITEM_CROSSING;
+    const int x = bounds.x / TILE_SIZE, y = bounds.y / TILE_SIZE;
+    if ((bounds.x + bounds.width - 1) / TILE_SIZE != x || (bounds.y + bounds.height - 1) / TILE_SIZE != y)
+        return ITEM_CROSSING;
+    return y * columns + x;
+}
+
+static void deferItem(const DrawBatch *src, const int kind, const int i) {
+    DrawBatch *dst = deferred + kind;
+    const int perItem = coordsPerItem(kind);
+    batchReserve(dst, perItem);
+    memcpy(dst->coords + perItem * dst->count, src->coords + perItem * i, sizeof(Point2i) * perItem);
+    if (kind == BATCH_CIRCLES)
+        dst->radii[dst->count] = src->radii[i];
+    dst->bounds[dst->count] = src->bounds[i];
+    dst->colors[dst->count++] = src->colors[i];
+}
+
+// a tile draws its own items up to the first crossing item that reaches it. that one and everything
+// after it over the tile are deferred, so every pixel still gets its items in batch order.
+// the rest is a counting sort, which keeps the order within every tile
+static void binByTile(const DrawBatch *batches, const int width, const int height, const int columns,
+                      const int rows) {
+    const int tiles = columns * rows;
+    if (binStartCapacity < BATCH_KIND_COUNT * (tiles + 1)) {
+        binStartCapacity = BATCH_KIND_COUNT * (tiles + 1);
+        binStart = realloc(binStart, sizeof(int) * binStartCapacity);
+        binFill = realloc(binFill, sizeof(int) * binStartCapacity);
+        firstCrossing = realloc(firstCrossing, sizeof(int) * binStartCapacity);
+    }
+
+    // items are numbered across the kinds in drawing order
+    int order = 0;
+    for (int t = 0; t < tiles; ++t)
+        firstCrossing[t] = INT_MAX;
+    for (int kind = 0; kind < BATCH_KIND_COUNT; ++kind) {
+        const DrawBatch *batch = batches + kind;
+        for (int i = 0; i < batch->count; ++i, ++order) {
+            if (itemTile(batch->bounds[i], width, height, columns) != ITEM_CROSSING)
+                continue;
+            const Rect2i visible = rect_intersect(batch->bounds[i], (Rect2i){0, 0, width, height});
+            const int x1 = (visible.x + visible.width - 1) / TILE_SIZE, y1 = (visible.y + visible.height - 1) / TILE_SIZE;
+            for (int y = visible.y / TILE_SIZE; y <= y1; ++y)
+                for (int x = visible.x / TILE_SIZE; x <= x1; ++x)
+                    if (firstCrossing[y * columns + x] == INT_MAX)
+                        firstCrossing[y * columns + x] = order;
+        }
+    }
+
+    order = 0;
+    for (int kind = 0; kind < BATCH_KIND_COUNT; ++kind) {
+        const DrawBatch *batch = batches + kind;
+        int *start = binStart + kind * (tiles + 1);
+        memset(start, 0, sizeof(int) * (tiles + 1));
+        if (itemTilesCapacity < batch->count)
+            itemTiles = realloc(itemTiles, sizeof(int) * (itemTilesCapacity = batch->count));
+
+        for (int i = 0; i < batch->count; ++i, ++order) {
+            const int tile = itemTile(batch->bounds[i], width, height, columns);
+            itemTiles[i] = tile >= 0 && order < firstCrossing[tile] ? tile : -1;
+            if (itemTiles[i] >= 0)
+                ++start[tile + 1];
+            else if (tile != ITEM_OFF_WINDOW)
+                deferItem(batch, kind, i);
+        }
+        for (int t = 0; t < tiles; ++t)
+            start[t + 1] += start[t];
+
+        if (binItemsCapacity[kind] < start[tiles]) {
+            binItemsCapacity[kind] = start[tiles];
+            binItems[kind] = realloc(binItems[kind], sizeof(int) * binItemsCapacity[kind]);
+        }
+        memcpy(binFill, start, sizeof(int) * tiles);
+        for (int i = 0; i < batch->count; ++i)
+            if (itemTiles[i] >= 0)
+                binItems[kind][binFill[itemTiles[i]]++] = i;
+    }
+}
+
+static void drawTile(TileWorker *worker, const Window *window, const DrawBatch *batches, const int tile,
+                     const int columns, const int rows) {
+    const int tiles = columns * rows;
+    const int x = tile % columns * TILE_SIZE, y = tile / columns * TILE_SIZE;
+    int any = 0;
+
+    for (int kind = 0; kind < BATCH_KIND_COUNT; ++kind) {
+        const DrawBatch *src = batches + kind;
+        DrawBatch *dst = worker->batches + kind;
+        const int *start = binStart + kind * (tiles + 1);
+        const int perItem = coordsPerItem(kind);
+
+        dst->count = 0;
+        for (int j = start[tile]; j < start[tile + 1]; ++j) {
+            const int i = binItems[kind][j];
+            batchReserve(dst, perItem);
+            for (int c = 0; c < perItem; ++c) {
+                const Point2i p = src->coords[perItem * i + c];
+                dst->coords[perItem * dst->count + c] = (Point2i){p.x - x, p.y - y};
+            }
+            if (kind == BATCH_CIRCLES)
+                dst->radii[dst->count] = src->radii[i];
+            dst->colors[dst->count++] = src->colors[i];
+        }
+        any |= dst->count != 0;
+    }
+    if (!any)
+        return;
+
+    const int width = window->width - x < TILE_SIZE ? window->width - x : TILE_SIZE;
+    const int height = window->height - y < TILE_SIZE ? window->height - y : TILE_SIZE;
+    moveSubWindow(worker->tile, window, x, y, width, height);
+    drawBatches(worker->tile, worker->batches, worker->passMs);
+}
+
+static inline int workerIndex() {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+// tiles never share a pixel, so they can be drawn in any order on any thread
+static void drawTiled(const Window *window, const DrawBatch *batches, const int columns, const int rows,
+                      const int threads) {
+    binByTile(batches, window->width, window->height, columns, rows);
+
+    if (countWorkers < threads) {
+        workers = realloc(workers, sizeof(TileWorker) * threads);
+        for (; countWorkers < threads; ++countWorkers) {
+            memset(workers + countWorkers, 0, sizeof(TileWorker));
+            workers[countWorkers].tile = getSubWindow(window, 0, 0, 1, 1);
+        }
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(dynamic)
+#endif
+    for (int tile = 0; tile < columns * rows; ++tile)
+        drawTile(workers + workerIndex(), window, batches, tile, columns, rows);
+
+    drawBatches(window, deferred, passMs);
+    for (int kind = 0; kind < BATCH_KIND_COUNT; ++kind)
+        deferred[kind].count = 0;
+
+    for (int i = 0; i < threads; ++i) {
+        for (int kind = 0; kind < BATCH_KIND_COUNT; ++kind) {
+            passMs[kind] += workers[i].passMs[kind];
+            workers[i].passMs[kind] = 0;
+        }
+    }
+}
+
+void flushBatches(const Window *window, DrawBatch *batches) {
+    int items = 0;
+    for (int kind = 0; kind < BATCH_KIND_COUNT; ++kind)
+        items += batches[kind].count;
+
+#ifdef _OPENMP
+    const int threads = rasterThreads > 0 ? rasterThreads : omp_get_max_threads();
+#else
+    const int threads = 1;
+#endif
+    const int columns = (window->width + TILE_SIZE - 1) / TILE_SIZE;
+    const int rows = (window->height + TILE_SIZE - 1) / TILE_SIZE;
+
+    if (threads == 1 || items < MIN_TILED_ITEMS || columns * rows == 1)
+        drawBatches(window, batches, passMs);
+    else
+        drawTiled(window, batches, columns, rows, threads);
+
+    for (int kind = 0; kind < BATCH_KIND_COUNT; ++kind)
+        batches[kind].count = 0;
+}
+
+void setRasterThreads(const int threads) {
+    rasterThreads = threads;
+}
+
+int getRasterThreads() {
+    return rasterThreads;
+}
+
+void takeBatchTimes(double *ms) {
+    for (int kind = 0; kind < BATCH_KIND_COUNT; ++kind) {
+        ms[kind] = passMs[kind];
+        passMs[kind] = 0;
+    }
+}
@@ -1,37 +1,398 @@
 #include "file_manage.h"
 #include "console.h"
 #include "geom_errors.h"
+#include "geom_utils.h"
+#include "board.h"
+#include "mapped_file.h"
+#include "object.h"
+#include "object_index.h"
+#include "script_cache.h"
+#include "utils.h"
 
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#define SCENE_MAGIC 0x53424747u // "GGBS"
+#define SCENE_VERSION 1
+#define NO_POINT 0xffffffffu
+
 extern const char *errorText;
 extern int errorType;
-char buffer[256];
+extern GeomObject *pointSet, *lineSet, *circleSet;
+
+// a scene file holds, in native byte order and each section 4-byte aligned: the header, x[points],
+// y[points], op[points] and numParents[points] as bytes, the parents of every point in turn as point
+// numbers, objects[objects], then the names. nothing in it is a pointer, points are numbered in the
+// order they are stored and a parent always comes before its children
+typedef struct {
+    uint32_t magic, version;
+    uint32_t countPoints, countEdges, countObjects, namesSize;
+} SceneHeader;
+
+typedef struct {
+    uint8_t type, show;
+    uint16_t reserved;
+    int32_t color;
+    uint32_t name; // offset into the names
+    uint32_t pt1, pt2; // pt2 is NO_POINT for a circle of fixed radius
+    float radius;
+} SceneObject;
+
+// where each section of a scene with these counts starts
+typedef struct {
+    size_t x, y, op, numParents, parents, objects, names, size;
+} SceneLayout;
 
-static const char *errorInline(const char *error, const int line) {
-    static char errorTemplate[15 + 5 + 64] = "Error in line ";
-    sprintf(errorTemplate + 14, "%d: %s", line, error);
-    return errorTemplate;
+// a word of the script, where it sits in the mapped file
+typedef struct {
+    size_t offset, length;
+} Span;
+
+static inline int isBlank(const char c) {
+    return c == ' ' || c == '\t' || c == '\r';
 }
 
+// the words of [begin, end) as spans into the mapped file, tokenizing copies nothing. runLine copies
+// the words out once, for each line it executes
+static int tokenizeLine(const char *data, size_t begin, const size_t end, Span **spans, int *capacity) {
+    int count = 0;
+    while (1) {
+        while (begin < end && isBlank(data[begin]))
+            ++begin;
+        if (begin == end)
+            return count;
+
+        const size_t start = begin;
+        while (begin < end && !isBlank(data[begin]))
+            ++begin;
+        if (count == *capacity)
+            *spans = realloc(*spans, sizeof(Span) * (*capacity = *capacity ? *capacity * 2 : 16));
+        (*spans)[count++] = (Span){start, begin - start};
+    }
+}
+
+// the commands want NUL terminated words, those of one line are copied out just before it runs
+static int runLine(const char *data, const Span *spans, const int count, const int line) {
+    static char *words = NULL;
+    static const char **argv = NULL;
+    static size_t wordsCapacity = 0;
+    static int argvCapacity = 0;
+
+    size_t size = 0;
+    for (int i = 0; i < count; ++i)
+        size += spans[i].length + 1;
+    if (wordsCapacity < size)
+        words = realloc(words, wordsCapacity = size * 2);
+    if (argvCapacity < count)
+        argv = realloc(argv, sizeof(char *) * (argvCapacity = count * 2));
+
+    char *word = words;
+    for (int i = 0; i < count; ++i) {
+        memcpy(word, data + spans[i].offset, spans[i].length);
+        word[spans[i].length] = '\0';
+        argv[i] = word;
+        word += spans[i].length + 1;
+    }
+    recordCommand(argv[0], line);
+    return executeCommand(count, argv);
+}
+
+// load-src <file> [--no-render]. the script only changes the scene, the board is drawn once at the end
+// or at its `refresh` lines. with --no-render it is not drawn at all. a script seen before with the
+// same contents is replayed from its cache, see script_cache.h
 int load_src(const int argc, const char **argv) {
-    if(argc == 1)
+    const char *filename = NULL;
+    RefreshMode mode = REFRESH_DEFERRED;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--no-render") == 0)
+            mode = REFRESH_DISABLED;
+        else
+            filename = argv[i];
+    }
+    if(filename == NULL)
         return throwError(ERROR_NO_ARG_GIVEN, "Please give a file.");
 
-    const char *filename = argv[1];
-
-    FILE *file = fopen(filename, "r");
-    if(file == NULL)
+    MappedFile file;
+    if(mapFile(filename, &file) != 0)
         return throwError(ERROR_CANNOT_OPEN_FILE, cannotOpenFileError(filename));
 
-    int count = 1;
-    while(fgets(buffer, 256, file)) {
-        if(processCommand(buffer) != 0)
-            return throwError(errorType, errorInline(errorText, count));
-        ++count;
+    // a script loaded by a --no-render one stays quiet too
+    const RefreshMode outer = setRefreshMode(mode);
+    if (outer > mode)
+        setRefreshMode(outer);
+
+    const uint64_t hash = hashBytes(file.data, file.size);
+    char *cacheName = malloc(strlen(filename) + sizeof(".ggbc"));
+    strcat(strcpy(cacheName, filename), ".ggbc");
+
+    int line = 1, error = 0;
+    if (replayCache(cacheName, hash, &error, &line)) {
+        if (error != 0)
+            error = throwError(errorType, errorInline(errorText, line));
+    } else {
+        const int recording = beginRecording();
+
+        // lines may be as long as they like, a nested load-src keeps its own spans
+        Span *spans = NULL;
+        int capacity = 0;
+        for (size_t begin = 0; begin < file.size; ++line) {
+            const char *newline = memchr(file.data + begin, '\n', file.size - begin);
+            const size_t end = newline != NULL ? (size_t) (newline - file.data) : file.size;
+
+            const int count = tokenizeLine(file.data, begin, end, &spans, &capacity);
+            if(count != 0 && runLine(file.data, spans, count, line) != 0) {
+                error = throwError(errorType, errorInline(errorText, line));
+                break;
+            }
+            begin = end + 1;
+        }
+        free(spans);
+
+        if (recording)
+            endRecording(cacheName, hash, error == 0);
+    }
+    free(cacheName);
+    unmapFile(&file);
+
+    setRefreshMode(outer);
+    if (mode != REFRESH_DISABLED)
+        refreshBoard();
+    return error;
+}
+
+static inline size_t align4(const size_t size) {
+    return (size + 3) & ~(size_t) 3;
+}
+
+static SceneLayout sceneLayout(const SceneHeader *header) {
+    SceneLayout layout;
+    layout.x = sizeof(SceneHeader);
+    layout.y = layout.x + sizeof(float) * header->countPoints;
+    layout.op = layout.y + sizeof(float) * header->countPoints;
+    layout.numParents = layout.op + align4(header->countPoints);
+    layout.parents = layout.numParents + align4(header->countPoints);
+    layout.objects = layout.parents + sizeof(uint32_t) * header->countEdges;
+    layout.names = layout.objects + sizeof(SceneObject) * header->countObjects;
+    layout.size = layout.names + header->namesSize;
+    return layout;
+}
+
+// every object, oldest first. the sets are newest first, so they are merged from their tails
+static int collectObjects(GeomObject ***objects) {
+    GeomObject *const sets[3] = {pointSet, lineSet, circleSet};
+    GeomObject *tails[3] = {NULL, NULL, NULL};
+    int count = 0;
+    for (int i = 0; i < 3; ++i)
+        for (GeomObject *obj = sets[i]; obj != NULL; obj = obj->next, ++count)
+            tails[i] = obj;
+
+    *objects = malloc(sizeof(GeomObject *) * (count ? count : 1));
+    for (int i = 0; i < count; ++i) {
+        int oldest = -1;
+        for (int j = 0; j < 3; ++j)
+            if (tails[j] != NULL && (oldest < 0 || tails[j]->serial < tails[oldest]->serial))
+                oldest = j;
+        (*objects)[i] = tails[oldest];
+        tails[oldest] = tails[oldest]->prev;
     }
+    return count;
+}
+
+// save-scene <file>. the objects, their points and how those derive from each other, as they are now
+int save_scene(const int argc, const char **argv) {
+    if (argc == 1)
+        return throwError(ERROR_NO_ARG_GIVEN, noArgGiven(*argv));
+
+    GeomObject **objects;
+    const int countObjects = collectObjects(&objects);
+
+    // a point is numbered after the object it was made for, so its parents already have theirs
+    int *numbers = malloc(sizeof(int) * (pointCoords.count ? pointCoords.count : 1));
+    for (int i = 0; i < pointCoords.count; ++i)
+        numbers[i] = -1;
+    SceneHeader header = {SCENE_MAGIC, SCENE_VERSION, 0, 0, (uint32_t) countObjects, 0};
+    for (int i = 0; i < countObjects; ++i) {
+        header.namesSize += strlen(objects[i]->name) + 1;
+        if (objects[i]->type != POINT)
+            continue;
+        const PointObject *pt = objects[i]->ptr->point;
+        numbers[pt->index] = (int) header.countPoints++;
+        header.countEdges += pt->numParents;
+    }
+
+    const SceneLayout layout = sceneLayout(&header);
+    char *data = calloc(layout.size, 1);
+    memcpy(data, &header, sizeof(header));
+    float *x = (float *) (data + layout.x), *y = (float *) (data + layout.y);
+    uint8_t *op = (uint8_t *) (data + layout.op), *numParents = (uint8_t *) (data + layout.numParents);
+    uint32_t *parents = (uint32_t *) (data + layout.parents);
+    SceneObject *records = (SceneObject *) (data + layout.objects);
+    char *names = data + layout.names;
+
+    int countPoints = 0, error = 0;
+    for (int i = 0; i < countObjects; ++i) {
+        const GeomObject *obj = objects[i];
+        SceneObject *record = records + i;
+        record->type = (uint8_t) obj->type;
+        record->show = (uint8_t) (obj->show != 0);
+        record->color = obj->color;
+        record->name = (uint32_t) (names - (data + layout.names));
+        record->pt2 = NO_POINT;
+        record->radius = 0;
+        names = strcpy(names, obj->name) + strlen(obj->name) + 1;
+
+        switch (obj->type) {
+            case POINT: {
+                const PointObject *pt = obj->ptr->point;
+                const Point2f p = pointCoord(pt);
+                record->pt1 = countPoints;
+                x[countPoints] = p.x;
+                y[countPoints] = p.y;
+                op[countPoints] = (uint8_t) pt->op;
+                numParents[countPoints++] = (uint8_t) pt->numParents;
+                for (int j = 0; j < pt->numParents; ++j)
+                    *parents++ = numbers[pt->parents[j]->index];
+                break;
+            }
+            case CIRCLE:
+                record->pt1 = numbers[obj->ptr->circle.center->index];
+                if (obj->ptr->circle.pt != NULL)
+                    record->pt2 = numbers[obj->ptr->circle.pt->index];
+                else
+                    record->radius = obj->ptr->circle.radius;
+                break;
+            default:
+                record->pt1 = numbers[obj->ptr->line.pt1->index];
+                record->pt2 = numbers[obj->ptr->line.pt2->index];
+        }
+    }
+
+    FILE *file = fopen(argv[1], "wb");
+    if (file == NULL || fwrite(data, layout.size, 1, file) != 1)
+        error = throwError(ERROR_CANNOT_OPEN_FILE, cannotOpenFileError(argv[1]));
+    if (file != NULL && fclose(file) != 0 && error == 0)
+        error = throwError(ERROR_CANNOT_OPEN_FILE, cannotOpenFileError(argv[1]));
+
+    free(data);
+    free(numbers);
+    free(objects);
+    return error;
+}
+
+// checks everything load_scene goes on to use, counting what it will allocate
+static int checkScene(const char *data, const SceneHeader *header, const SceneLayout *layout,
+                      int *countByParents, int *countByType, int *countUsers) {
+    const uint8_t *op = (const uint8_t *) (data + layout->op);
+    const uint8_t *numParents = (const uint8_t *) (data + layout->numParents);
+    const uint32_t *parents = (const uint32_t *) (data + layout->parents);
+    const SceneObject *records = (const SceneObject *) (data + layout->objects);
+    const char *names = data + layout->names;
+
+    uint32_t edge = 0;
+    for (uint32_t i = 0; i < header->countPoints; ++i) {
+        if (op[i] >= DERIVE_OP_COUNT || numParents[i] != (op[i] == DERIVE_MIDPOINT ? 2 : 0) ||
+            header->countEdges - edge < numParents[i])
+            return -1;
+        for (int j = 0; j < numParents[i]; ++j)
+            if (parents[edge++] >= i)
+                return -1;
+        ++countByParents[numParents[i]];
+    }
+    if (edge != header->countEdges)
+        return -1;
 
-    fclose(file);
+    if (header->namesSize != 0 && names[header->namesSize - 1] != '\0')
+        return -1;
+    for (uint32_t i = 0; i < header->countObjects; ++i) {
+        const SceneObject *record = records + i;
+        if (record->type < POINT || record->type > SEG || record->name >= header->namesSize ||
+            names[record->name] == '\0' || record->pt1 >= header->countPoints)
+            return -1;
+        if (record->pt2 == NO_POINT ? record->type != POINT && record->type != CIRCLE
+                                    : record->type == POINT || record->pt2 >= header->countPoints)
+            return -1;
+        ++countByType[record->type];
+        *countUsers += record->pt2 == NO_POINT ? 1 : 2;
+    }
     return 0;
-}
\ No newline at end of file
+}
+
+// load-scene <file>. replaces the board's objects with those of a save-scene file
+int load_scene(const int argc, const char **argv) {
+    if (argc == 1)
+        return throwError(ERROR_NO_ARG_GIVEN, noArgGiven(*argv));
+
+    MappedFile file;
+    if (mapFile(argv[1], &file) != 0)
+        return throwError(ERROR_CANNOT_OPEN_FILE, cannotOpenFileError(argv[1]));
+
+    SceneHeader header = {0};
+    if (file.size >= sizeof(header))
+        memcpy(&header, file.data, sizeof(header));
+    const SceneLayout layout = sceneLayout(&header);
+    int countByParents[MAX_PARENTS + 1] = {0}, countByType[SEG + 1] = {0}, countUsers = 0;
+    if (header.magic != SCENE_MAGIC || header.version != SCENE_VERSION || layout.size != file.size ||
+        checkScene(file.data, &header, &layout, countByParents, countByType, &countUsers) != 0) {
+        unmapFile(&file);
+        return throwError(ERROR_INVALID_ARG, invalidArg("scene", "Not a scene file of this version"));
+    }
+
+    const float *x = (const float *) (file.data + layout.x), *y = (const float *) (file.data + layout.y);
+    const uint8_t *op = (const uint8_t *) (file.data + layout.op);
+    const uint8_t *numParents = (const uint8_t *) (file.data + layout.numParents);
+    const uint32_t *parents = (const uint32_t *) (file.data + layout.parents);
+    const SceneObject *records = (const SceneObject *) (file.data + layout.objects);
+    const char *names = file.data + layout.names;
+
+    clearScene();
+    reservePointData(countByParents, countUsers);
+    reserveGeomObjects(countByType[POINT], countByType[LINE] + countByType[RAY] + countByType[SEG],
+                       countByType[CIRCLE]);
+
+    PointObject **pts = malloc(sizeof(PointObject *) * (header.countPoints ? header.countPoints : 1));
+    for (uint32_t i = 0; i < header.countPoints; ++i) {
+        PointObject *ptParents[MAX_PARENTS];
+        for (int j = 0; j < numParents[i]; ++j)
+            ptParents[j] = pts[*parents++];
+        pts[i] = createPointData((Point2f){x[i], y[i]}, ptParents, numParents[i], (DeriveOp) op[i]);
+    }
+
+    int error = 0;
+    for (uint32_t i = 0; i < header.countObjects; ++i) {
+        const SceneObject *record = records + i;
+        const char *name = names + record->name;
+        if (objectIndexFind(name) != NULL) {
+            clearScene();
+            error = throwError(ERROR_DUPLICATE_NAME, duplicateName(name));
+            break;
+        }
+
+        ObjectSelector arg;
+        switch (record->type) {
+            case POINT:
+                arg.point = pts[record->pt1];
+                break;
+            case CIRCLE:
+                arg.circle.center = pts[record->pt1];
+                if (record->pt2 == NO_POINT) {
+                    arg.circle.pt = NULL;
+                    arg.circle.radius = record->radius;
+                } else {
+                    arg.circle.pt = pts[record->pt2];
+                    arg.circle.radius = dist2f(pointCoord(arg.circle.center), pointCoord(arg.circle.pt));
+                    arg.circle.version = pointVersion(arg.circle.center) + pointVersion(arg.circle.pt);
+                }
+                break;
+            default:
+                arg.line = (LineObject){pts[record->pt1], pts[record->pt2]};
+        }
+        createGeomObject(record->type, &arg, name, record->show, record->color);
+    }
+
+    free(pts);
+    unmapFile(&file);
+    refreshBoard();
+    return error;
+}
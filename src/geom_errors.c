@@ -4,12 +4,13 @@
 #include <string.h>
 
 const char *errorText = NULL;
+const char *messageText = NULL;
 int errorType = 0;
 
 
 const char *objectNotFound(const char *name) {
-    static char error[32] = "Object not found: ";
-    memcpy(error + 18, name, 8);
+    static char error[19 + 32] = "Object not found: ";
+    strncpy(error + 18, name, 32);
     return error;
 }
 
@@ -53,13 +54,36 @@ const char *unknownArgs(const char *arg) {
     return errorTemplate;
 }
 
+const char *duplicateName(const char *name) {
+    static char errorTemplate[22 + 32] = "Name already in use: ";
+    strncpy(errorTemplate + 21, name, 32);
+    return errorTemplate;
+}
+
+// error may be the result of an earlier call, as with nested scripts
+const char *errorInline(const char *error, const int line) {
+    static char errorTemplate[15 + 10 + 128] = "Error in line ";
+    char text[sizeof(errorTemplate) - 14 - 13]; // what is left after the longest "%d: "
+    strncpy(text, error, sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+    snprintf(errorTemplate + 14, sizeof(errorTemplate) - 14, "%d: %s", line, text);
+    return errorTemplate;
+}
+
 int throwError(const GeomErrorType type, const char *text) {
     errorType = type;
     errorText = text;
     return type;
 }
 
+// not an error, just something for the console to display
+int showMessage(const char *text) {
+    messageText = text;
+    return 0;
+}
+
 void resetError() {
     errorType = 0;
     errorText = NULL;
+    messageText = NULL;
 }
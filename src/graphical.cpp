@@ -1,7 +1,9 @@
 #include "opencv2/core.hpp"
 #include "opencv2/imgproc.hpp"
-#include "opencv2/highgui.hpp"
 #include "opencv2/core/utils/logger.hpp"
+#ifndef GGB_HEADLESS
+#include "opencv2/highgui.hpp"
+#endif
 #include "geometry.h"
 #include "graphical.h"
 
@@ -9,11 +11,36 @@ static inline cv::Scalar toScalar(const int &rgb) {
     return {(double) (rgb & 0xff), (double) ((rgb >> 8) & 0xff), (double) (rgb >> 16)};
 }
 
+// neighbouring primitives tend to share a color, convert only when it changes
+class ColorCache {
+public:
+    const cv::Scalar &operator()(const int rgb) {
+        if (rgb != last) {
+            last = rgb;
+            color = toScalar(rgb);
+        }
+        return color;
+    }
+
+private:
+    int last = -1;
+    cv::Scalar color;
+};
+
+// windows only live in memory, nothing is shown and no events come in
+static bool headless = false;
+
 extern "C" {
-void graphicalInit() {
+int graphicalInit(const int offscreen) {
 #ifdef WIN32
     cv::utils::logging::setLogLevel(cv::utils::logging::LOG_LEVEL_SILENT);
 #endif
+#ifdef GGB_HEADLESS
+    headless = true;
+#else
+    headless = offscreen != 0;
+#endif
+    return headless;
 }
 
 Window *getNewWindow(const char *name, const int width, const int height) {
@@ -39,6 +66,17 @@ Window *getSubWindow(const Window *window, const int x, const int y, const int w
     return sub;
 }
 
+void moveSubWindow(Window *sub, const Window *window, const int x, const int y, const int width, const int height) {
+    sub->width = width;
+    sub->height = height;
+    *(cv::Mat *) sub->data = (*(cv::Mat *) window->data)(cv::Rect(x, y, width, height));
+}
+
+// same size windows, dst may be a sub-window
+void windowCopy(const Window *dst, const Window *src) {
+    ((cv::Mat *) src->data)->copyTo(*(cv::Mat *) dst->data);
+}
+
 void windowFill(const Window *window, const uchar r, const uchar g, const uchar b) {
     *(cv::Mat *) window->data = cv::Scalar(b, g, r);
 }
@@ -100,27 +138,99 @@ void drawCircle(const Window *window, const Point2i center, const int radius, co
                color, thickness);
 }
 
+void drawPointBatch(const Window *window, const Point2i *points, const int *colors, const int count) {
+    cv::Mat &img = *(cv::Mat *) window->data;
+    const auto *pts = reinterpret_cast<const cv::Point2i *>(points);
+    ColorCache color;
+
+    for (int i = 0; i < count; ++i)
+        cv::circle(img, pts[i], 3, color(colors[i]), -1);
+}
+
+void drawLineBatch(const Window *window, const Point2i *ends, const int *colors, const int count,
+                   const int thickness) {
+    cv::Mat &img = *(cv::Mat *) window->data;
+    const auto *pts = reinterpret_cast<const cv::Point2i *>(ends);
+    ColorCache color;
+
+    for (int i = 0; i < count; ++i)
+        cv::line(img, pts[2 * i], pts[2 * i + 1], color(colors[i]), thickness);
+}
+
+void drawCircleBatch(const Window *window, const Point2i *centers, const int *radii, const int *colors,
+                     const int count, const int thickness) {
+    cv::Mat &img = *(cv::Mat *) window->data;
+    const auto *pts = reinterpret_cast<const cv::Point2i *>(centers);
+    ColorCache color;
+
+    for (int i = 0; i < count; ++i)
+        cv::circle(img, pts[i], radii[i], color(colors[i]), thickness);
+}
+
 void drawText(const Window *window, const char *text, const Point2i leftbottom, const int rgb, const int fontsize) {
     cv::putText(*(cv::Mat *) window->data, text, reinterpret_cast<const cv::Point2i &>(leftbottom),
                 cv::FONT_HERSHEY_SIMPLEX, fontsize / 20.0, toScalar(rgb));
 }
 
+// packed rgb rows, width * height * 3 bytes
+void windowRead(const Window *window, unsigned char *rgb) {
+    cv::Mat dst(window->height, window->width, CV_8UC3, rgb);
+    cv::cvtColor(*(cv::Mat *) window->data, dst, cv::COLOR_BGR2RGB);
+}
+
+#ifdef GGB_HEADLESS
+char waitKey(const int ms) {
+    return -1;
+}
+
+int mouseWheelDelta(const int flags) {
+    return 0;
+}
+
+void setMouseCallback(const Window *window, void (*callback)(int, int, int, int, void *), void *userdata) {
+}
+
+void showWindow(const Window *window) {
+}
+
+int windowVisible(const Window *window) {
+    return 0;
+}
+
+void destroyWindow(const Window *window) {
+    delete[] window->name;
+    delete (cv::Mat *) window->data;
+    delete window;
+}
+#else
 char waitKey(const int ms) {
-    return (char) cv::waitKey(ms);
+    return headless ? (char) -1 : (char) cv::waitKey(ms);
+}
+
+int mouseWheelDelta(const int flags) {
+    return cv::getMouseWheelDelta(flags);
 }
 
 void setMouseCallback(const Window *window, void (*callback)(int, int, int, int, void *), void *userdata) {
-    cv::setMouseCallback(window->name, callback, userdata);
+    if (!headless)
+        cv::setMouseCallback(window->name, callback, userdata);
 }
 
 void showWindow(const Window *window) {
-    cv::imshow(window->name, *(cv::Mat *) window->data);
+    if (!headless)
+        cv::imshow(window->name, *(cv::Mat *) window->data);
+}
+
+int windowVisible(const Window *window) {
+    return !headless && cv::getWindowProperty(window->name, cv::WND_PROP_VISIBLE) >= 1;
 }
 
 void destroyWindow(const Window *window) {
-    cv::destroyWindow(window->name);
+    if (!headless)
+        cv::destroyWindow(window->name);
     delete[] window->name;
     delete (cv::Mat *) window->data;
     delete window;
 }
+#endif
 }
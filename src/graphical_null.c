@@ -0,0 +1,94 @@
+// stands in for graphical.cpp where nothing is ever drawn (ggb-batch): windows keep only their size
+#include "graphical.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int graphicalInit(const int offscreen) {
+    return 1;
+}
+
+Window *getNewWindow(const char *name, const int width, const int height) {
+    Window *w = malloc(sizeof(Window));
+    w->width = width;
+    w->height = height;
+    w->name = NULL;
+    w->data = NULL;
+    return w;
+}
+
+Window *getSubWindow(const Window *window, const int x, const int y, const int width, const int height) {
+    return getNewWindow(NULL, width, height);
+}
+
+void moveSubWindow(Window *sub, const Window *window, const int x, const int y, const int width, const int height) {
+    sub->width = width;
+    sub->height = height;
+}
+
+void windowCopy(const Window *dst, const Window *src) {
+}
+
+void windowFill(const Window *window, const unsigned char r, const unsigned char g, const unsigned char b) {
+}
+
+void drawPoint(const Window *window, const Point2i p, const int rgb) {
+}
+
+void drawPointSet(const Window *window, const Point2i *points, const int npoints, const int rgb) {
+}
+
+void drawLine(const Window *window, const Point2i p1, const Point2i p2, const int rgb, const int thickness) {
+}
+
+void drawRect(const Window *window, const Point2i lefttop, const int width, const int height, const int rgb,
+              const int thickness) {
+}
+
+void drawPoly(const Window *window, const Point2i *points, const int nponts, const int rgb, const int thickness,
+              const int connect) {
+}
+
+void drawCircle(const Window *window, const Point2i center, const int radius, const int rgb, const int thickness) {
+}
+
+void drawPointBatch(const Window *window, const Point2i *points, const int *colors, const int count) {
+}
+
+void drawLineBatch(const Window *window, const Point2i *ends, const int *colors, const int count,
+                   const int thickness) {
+}
+
+void drawCircleBatch(const Window *window, const Point2i *centers, const int *radii, const int *colors,
+                     const int count, const int thickness) {
+}
+
+// a blank board, should anything still ask
+void windowRead(const Window *window, unsigned char *rgb) {
+    memset(rgb, 0xff, (size_t) window->width * window->height * 3);
+}
+
+void drawText(const Window *window, const char *text, const Point2i leftbottom, const int rgb, const int fontsize) {
+}
+
+char waitKey(const int ms) {
+    return -1;
+}
+
+int mouseWheelDelta(const int flags) {
+    return 0;
+}
+
+void setMouseCallback(const Window *window, void (*callback)(int, int, int, int, void *), void *userdata) {
+}
+
+void showWindow(const Window *window) {
+}
+
+int windowVisible(const Window *window) {
+    return 0;
+}
+
+void destroyWindow(const Window *window) {
+    free((Window *) window);
+}
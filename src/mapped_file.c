@@ -0,0 +1,86 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+
+int mapFile(const char *filename, MappedFile *file) {
+    *file = (MappedFile){NULL, 0, NULL};
+    const HANDLE handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                      FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+        return -1;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size)) {
+        CloseHandle(handle);
+        return -1;
+    }
+    // a zero-length mapping cannot be created
+    if (size.QuadPart == 0) {
+        CloseHandle(handle);
+        return 0;
+    }
+
+    const HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(handle);
+    if (mapping == NULL)
+        return -1;
+
+    file->data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (file->data == NULL) {
+        CloseHandle(mapping);
+        return -1;
+    }
+    file->size = (size_t) size.QuadPart;
+    file->handle = mapping;
+    return 0;
+}
+
+void unmapFile(MappedFile *file) {
+    if (file->data != NULL) {
+        UnmapViewOfFile(file->data);
+        CloseHandle(file->handle);
+    }
+    *file = (MappedFile){NULL, 0, NULL};
+}
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int mapFile(const char *filename, MappedFile *file) {
+    *file = (MappedFile){NULL, 0, NULL};
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return -1;
+    }
+    // mmap refuses a zero length
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    void *data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return -1;
+    // read front to back once
+    madvise(data, (size_t) st.st_size, MADV_SEQUENTIAL);
+
+    file->data = data;
+    file->size = (size_t) st.st_size;
+    return 0;
+}
+
+void unmapFile(MappedFile *file) {
+    if (file->data != NULL)
+        munmap((void *) file->data, file->size);
+    *file = (MappedFile){NULL, 0, NULL};
+}
+#endif
@@ -1,49 +1,44 @@
 #include "points_manage.h"
+#include "derive.h"
 #include "object.h"
 #include "geom_utils.h"
 #include "geom_errors.h"
 #include "board.h"
+#include "draw_batch.h"
 #include "utils.h"
+#include "object_index.h"
+#include "slab.h"
+#include "script_cache.h"
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 // private
 GeomObject *pointSet = NULL, *lineSet = NULL, *circleSet = NULL;
 
-static int getArgs(ObjectType type, const char *arg1, const char *arg2, ObjectSelector *arg);
+#define NAME_SLOT_SIZE 32
 
-static void createGeomObject(ObjectType type, const ObjectSelector *arg, uint64_t id, int show, int rgb);
+static Slab pointObjectSlab = SLAB_INITIALIZER("point-obj", sizeof(GeomObject) + sizeof(PointObject *), 1024);
+static Slab lineObjectSlab = SLAB_INITIALIZER("line-obj", sizeof(GeomObject) + sizeof(LineObject), 1024);
+static Slab circleObjectSlab = SLAB_INITIALIZER("circle-obj", sizeof(GeomObject) + sizeof(CircleObject), 1024);
+static Slab nameSlab = SLAB_INITIALIZER("name", NAME_SLOT_SIZE, 1024);
+static unsigned defaultNameCount = 0;
+static unsigned objectSerial = 0;
 
-static int getOptionalObjectArgs(const char **argv, const char **endptr, uint64_t *id, int *show, int *rgb);
+static int getArgs(ObjectType type, const char *arg1, const char *arg2, ObjectSelector *arg);
 
-static GeomObject *findObjectHelper(GeomObject *head, uint64_t id);
+static void destroyGeomObject(GeomObject *obj);
 
-static Point2f midpointCallback(PointObject **pt);
+static int getOptionalObjectArgs(const char **argv, const char **endptr, const char **name, int *show, int *rgb);
 
 
 // public
-GeomObject *findObject(const ObjectType type, const uint64_t id) {
-    GeomObject *obj;
-    switch (type) {
-        case POINT:
-            return findObjectHelper(pointSet, id);
-        case CIRCLE:
-            return findObjectHelper(circleSet, id);
-        case ANY:
-            obj = findObjectHelper(pointSet, id);
-            if (obj != NULL)
-                return obj;
-            obj = findObjectHelper(lineSet, id);
-            if (obj != NULL)
-                return obj;
-            obj = findObjectHelper(circleSet, id);
-            return obj;
-        default:
-            obj = findObjectHelper(lineSet, id);
-            if (obj != NULL && obj->type != type)
-                return NULL;
-            return obj;
-    }
+GeomObject *findObject(const ObjectType type, const char *name) {
+    GeomObject *obj = objectIndexFind(name);
+    if (obj != NULL && type != ANY && obj->type != type)
+        return NULL;
+    return obj;
 }
 
 int create(const int argc, const char **argv) {
@@ -77,48 +72,125 @@ int create(const int argc, const char **argv) {
     if (argc < 4)
         return throwError(ERROR_NOT_ENOUGH_ARG, notEnoughArg(*argv));
 
-    int error = getArgs(type, argv[2], argv[3], &arg);
+    const char *name;
+    int show, rgb;
+    int error = getOptionalObjectArgs(argv + 4, argv + argc, &name, &show, &rgb);
     if (error != 0)
         return error;
 
-    uint64_t id;
-    int show, rgb;
-    error = getOptionalObjectArgs(argv + 4, argv + argc, &id, &show, &rgb);
+    error = getArgs(type, argv[2], argv[3], &arg);
     if (error != 0)
         return error;
 
-    createGeomObject(type, &arg, id, show, rgb);
+    createGeomObject(type, &arg, name, show, rgb);
+    refreshBoard();
+    return 0;
+}
+
+int clear(const int argc, const char **argv) {
+    clearScene();
+    refreshBoard();
+    return 0;
+}
+
+void clearScene() {
+    GeomObject *sets[3] = {pointSet, lineSet, circleSet};
+    for (int i = 0; i < 3; ++i)
+        for (const GeomObject *obj = sets[i]; obj != NULL; obj = obj->next)
+            if (strlen(obj->name) >= NAME_SLOT_SIZE)
+                free(obj->name);
+
+    pointSet = lineSet = circleSet = NULL;
+    objectIndexClear();
+    slabRelease(&pointObjectSlab);
+    slabRelease(&lineObjectSlab);
+    slabRelease(&circleObjectSlab);
+    slabRelease(&nameSlab);
+    clearPointData();
+    defaultNameCount = 0;
+
+    resetBoard();
+}
+
+void reserveGeomObjects(const int countPoints, const int countLines, const int countCircles) {
+    slabReserve(&pointObjectSlab, countPoints);
+    slabReserve(&lineObjectSlab, countLines);
+    slabReserve(&circleObjectSlab, countCircles);
+    slabReserve(&nameSlab, countPoints + countLines + countCircles);
+    objectIndexReserve(countPoints + countLines + countCircles);
+}
+
+// removes the object, every point derived from it and every object drawn from those points
+int delete_object(const int argc, const char **argv) {
+    if (argc == 1)
+        return throwError(ERROR_NO_ARG_GIVEN, noArgGiven(*argv));
+
+    GeomObject *obj = findObject(ANY, argv[1]);
+    if (obj == NULL)
+        return throwError(ERROR_NOT_FOUND_OBJECT, objectNotFound(argv[1]));
+
+    recordDelete(obj);
+    deleteObject(obj);
     refreshBoard();
     return 0;
 }
 
+void deleteObject(GeomObject *obj) {
+    static GeomObject **doomed = NULL;
+    static int capacity = 0;
+
+    PointObject **pts = NULL;
+    const int countPts = obj->type == POINT ? collectDescendants(obj->ptr->point, &pts) : 0;
+
+    int countObjs = 0;
+    if (capacity == 0)
+        doomed = malloc(sizeof(GeomObject *) * (capacity = 64));
+    obj->flags |= OBJECT_DELETING;
+    doomed[countObjs++] = obj;
+
+    for (int i = 0; i < countPts; ++i) {
+        for (const ObjectLink *link = pts[i]->users; link != NULL; link = link->next) {
+            if (link->obj->flags & OBJECT_DELETING)
+                continue;
+            if (countObjs == capacity)
+                doomed = realloc(doomed, sizeof(GeomObject *) * (capacity *= 2));
+            link->obj->flags |= OBJECT_DELETING;
+            doomed[countObjs++] = link->obj;
+        }
+    }
+
+    for (int i = 0; i < countObjs; ++i)
+        destroyGeomObject(doomed[i]);
+    for (int i = 0; i < countPts; ++i)
+        destroyPointData(pts[i]);
+}
+
 int midpoint(const int argc, const char **argv) {
     if (argc == 1)
         return throwError(ERROR_NO_ARG_GIVEN, noArgGiven(*argv));
 
     const GeomObject *pt2,
-            *pt1 = findObject(POINT, strhash64(argv[1]));
+            *pt1 = findObject(POINT, argv[1]);
     if (pt1 == NULL)
         return throwError(ERROR_NOT_FOUND_OBJECT, objectNotFound(argv[1]));
     if (argc >= 3) {
-        pt2 = findObject(POINT, strhash64(argv[2]));
+        pt2 = findObject(POINT, argv[2]);
         if (pt2 == NULL)
             return throwError(ERROR_NOT_FOUND_OBJECT, objectNotFound(argv[2]));
     } else {
         return throwError(ERROR_NOT_ENOUGH_ARG, notEnoughArg(*argv));
     }
 
-    uint64_t id;
+    const char *name;
     int show, rgb;
-    const int error = getOptionalObjectArgs(argv + 3, argv + argc, &id, &show, &rgb);
+    const int error = getOptionalObjectArgs(argv + 3, argv + argc, &name, &show, &rgb);
     if (error != 0)
         return error;
 
     PointObject *parents[2] = {pt1->ptr->point, pt2->ptr->point};
-    const PointObject *mid = createPointData(midpt(pt1->ptr->point->coord, pt2->ptr->point->coord),
-                                             parents, 2, &midpointCallback);
+    const PointObject *mid = createPointData(deriveCoord(DERIVE_MIDPOINT, parents), parents, 2, DERIVE_MIDPOINT);
 
-    createGeomObject(POINT, (ObjectSelector *) &mid, id, show, rgb);
+    createGeomObject(POINT, (ObjectSelector *) &mid, name, show, rgb);
     refreshBoard();
     return 0;
 }
@@ -127,17 +199,18 @@ int move_pt(const int argc, const char **argv) {
     if (argc == 1)
         return throwError(ERROR_NO_ARG_GIVEN, noArgGiven(*argv));
 
+    GeomObject *srcs[16], *dsts[16];
     PointObject *pts[16];
     int countpts = 0;
     for (const char **arg = argv + 1; countpts < 16; ++countpts, ++arg) {
-        const uint64_t hash = strhash64(*arg);
-        if(hash == STR_HASH64('t', 'o', 0, 0, 0, 0, 0, 0))
+        if(strhash64(*arg) == STR_HASH64('t', 'o', 0, 0, 0, 0, 0, 0))
             break;
 
-        const GeomObject *src = findObject(POINT, hash);
+        GeomObject *src = findObject(POINT, *arg);
         if (src == NULL)
             return throwError(ERROR_NOT_FOUND_OBJECT, objectNotFound(*arg));
 
+        srcs[countpts] = src;
         pts[countpts] = src->ptr->point;
     }
     if (countpts == 0)
@@ -146,70 +219,187 @@ int move_pt(const int argc, const char **argv) {
     Point2f dst[16];
     int countdst = 0;
     for(const char **arg = argv + 2 + countpts, **end = argv + argc; arg != end && countdst < countpts; ++countdst, ++arg) {
-        const uint64_t hash = strhash64(*arg);
-        const GeomObject *dst_ = findObject(POINT, hash);
+        GeomObject *dst_ = findObject(POINT, *arg);
         if (dst_ == NULL)
             return throwError(ERROR_NOT_FOUND_OBJECT, objectNotFound(*arg));
 
-        dst[countdst] = dst_->ptr->point->coord;
+        dsts[countdst] = dst_;
+        dst[countdst] = pointCoord(dst_->ptr->point);
     }
     if (countdst != countpts)
         return throwError(ERROR_INVALID_ARG, "The count of dst is different from pts");
 
+    recordMove(srcs, dsts, countpts);
     movePoints(pts, dst, countpts);
+    markPointsMoved();
     refreshBoard();
     return 0;
 }
 
-// private
-static Point2f midpointCallback(PointObject **pt) {
-    return midpt(pt[0]->coord, pt[1]->coord);
+int lazy_eval(const int argc, const char **argv) {
+    if (argc == 1)
+        return throwError(ERROR_NO_ARG_GIVEN, noArgGiven(*argv));
+
+    const char *end;
+    const int lazy = strtobool(argv[1], &end);
+    if (*end != '\0')
+        return throwError(ERROR_INVALID_ARG, invalidArg("lazy", "Please true/false"));
+
+    setLazyEvaluation(lazy);
+    recordLazy(lazy);
+    return 0;
 }
 
-static GeomObject *findObjectHelper(GeomObject *head, const uint64_t id) {
-    while (head != NULL) {
-        if (head->id == id)
-            break;
-        head = head->next;
+int set_threads(const int argc, const char **argv) {
+    if (argc == 1)
+        return throwError(ERROR_NO_ARG_GIVEN, noArgGiven(*argv));
+
+    char *end;
+    const int threads = (int) strtol(argv[1], &end, 10);
+    if (*end != '\0' || threads < 0)
+        return throwError(ERROR_INVALID_ARG, invalidArg("threads", "0 means one per core"));
+
+    setPropagationThreads(threads);
+    setRasterThreads(threads);
+    recordThreads(threads);
+    return 0;
+}
+
+int writeCoords(const char *filename) {
+    FILE *file = strcmp(filename, "-") == 0 ? stdout : fopen(filename, "w");
+    if (file == NULL)
+        return -1;
+
+    // the set is newest first
+    const GeomObject *last = pointSet;
+    while (last != NULL && last->next != NULL)
+        last = last->next;
+    for (const GeomObject *obj = last; obj != NULL; obj = obj->prev) {
+        const Point2f p = pointCoord(obj->ptr->point);
+        fprintf(file, "%s %.9g %.9g\n", obj->name, p.x, p.y);
     }
-    return head;
+
+    if (file == stdout)
+        return fflush(file) == 0 ? 0 : -1;
+    return fclose(file) == 0 ? 0 : -1;
 }
 
-static GeomObject *getNewObject(const ObjectType type) {
-    GeomObject *obj;
+// private
+static GeomObject **getObjectSet(const ObjectType type) {
     switch (type) {
         case POINT:
-            obj = malloc(sizeof(GeomObject) + sizeof(PointObject *));
-            obj->next = pointSet;
-            pointSet = obj;
-            return obj;
+            return &pointSet;
         case CIRCLE:
-            obj = malloc(sizeof(GeomObject) + sizeof(CircleObject));
-            obj->next = circleSet;
-            circleSet = obj;
-            return obj;
+            return &circleSet;
         case LINE:
         case RAY:
         case SEG:
-            obj = malloc(sizeof(GeomObject) + sizeof(LineObject));
-            obj->next = lineSet;
-            lineSet = obj;
-            return obj;
+            return &lineSet;
         default:
             return NULL;
     }
 }
 
-static void createGeomObject(const ObjectType type, const ObjectSelector *arg, const uint64_t id, const int show,
+static Slab *getObjectSlab(const ObjectType type) {
+    switch (type) {
+        case POINT:
+            return &pointObjectSlab;
+        case CIRCLE:
+            return &circleObjectSlab;
+        default:
+            return &lineObjectSlab;
+    }
+}
+
+static GeomObject *getNewObject(const ObjectType type) {
+    GeomObject **set = getObjectSet(type);
+    if (set == NULL)
+        return NULL;
+
+    GeomObject *obj = slabAlloc(getObjectSlab(type));
+    obj->prev = NULL;
+    obj->next = *set;
+    if (*set != NULL)
+        (*set)->prev = obj;
+    *set = obj;
+    return obj;
+}
+
+static void freeName(char *name) {
+    if (strlen(name) < NAME_SLOT_SIZE)
+        slabFree(&nameSlab, name);
+    else
+        free(name);
+}
+
+// every point the object is drawn from. returns the count
+static int getObjectPoints(GeomObject *obj, PointObject **pts) {
+    int count = 0;
+    switch (obj->type) {
+        case POINT:
+            pts[count++] = obj->ptr->point;
+            break;
+        case CIRCLE:
+            pts[count++] = obj->ptr->circle.center;
+            if (obj->ptr->circle.pt != NULL)
+                pts[count++] = obj->ptr->circle.pt;
+            break;
+        default:
+            pts[count++] = obj->ptr->line.pt1;
+            pts[count++] = obj->ptr->line.pt2;
+    }
+    return count;
+}
+
+static void destroyGeomObject(GeomObject *obj) {
+    PointObject *pts[2];
+    const int count = getObjectPoints(obj, pts);
+    for (int i = 0; i < count; ++i)
+        if (!(pts[i]->flags & POINT_MARKED))
+            removePointUser(pts[i], obj);
+
+    if (obj->prev != NULL)
+        obj->prev->next = obj->next;
+    else
+        *getObjectSet(obj->type) = obj->next;
+    if (obj->next != NULL)
+        obj->next->prev = obj->prev;
+
+    forgetObject(obj);
+    objectIndexRemove(obj);
+    freeName(obj->name);
+    slabFree(getObjectSlab(obj->type), obj);
+}
+
+static const char *getDefaultName() {
+    static char name[16];
+    do {
+        sprintf(name, "#%03u", ++defaultNameCount);
+    } while (objectIndexFind(name) != NULL);
+
+    return name;
+}
+
+GeomObject *createGeomObject(const ObjectType type, const ObjectSelector *arg, const char *name, const int show,
                              const int rgb) {
     GeomObject *obj = getNewObject(type);
     if (obj == NULL)
-        return;
+        return NULL;
+
+    const int defaultName = name == NULL;
+    if (defaultName)
+        name = getDefaultName();
 
-    obj->id = id;
+    // short names share a slab, longer ones get their own block
+    const size_t length = strlen(name) + 1;
+    obj->name = memcpy(length <= NAME_SLOT_SIZE ? slabAlloc(&nameSlab) : malloc(length), name, length);
     obj->type = type;
     obj->show = show;
     obj->color = rgb;
+    obj->flags = 0;
+    obj->serial = ++objectSerial;
+    obj->bounds = obj->cells = (Rect2i){0};
+    obj->boundsView = 0;
 
     switch (type) {
         case POINT:
@@ -225,25 +415,20 @@ static void createGeomObject(const ObjectType type, const ObjectSelector *arg, c
         default:
             break;
     }
-}
 
-static inline int randomColor() {
-    return (int) (random32() & 0xffffff);
-}
+    PointObject *pts[2];
+    const int count = getObjectPoints(obj, pts);
+    for (int i = 0; i < count; ++i)
+        addPointUser(pts[i], obj);
 
-static uint64_t getDefaultId() {
-    static uint64_t id = STR_HASH64('#', '0', '0', '0', 0, 0, 0, 0);
-    char *c = (char *) &id + 3;
-    do {
-        if (*c != '9') {
-            ++*c;
-            return id;
-        }
-        *c = '0';
-        --c;
-    } while (*c != '#');
+    objectIndexInsert(obj);
+    markObjectChanged(obj);
+    recordCreate(obj, defaultName);
+    return obj;
+}
 
-    return 0;
+int randomColor() {
+    return (int) (random32() & 0xffffff);
 }
 
 static int getPointArg(const char *arg1, const char *arg2, PointObject **arg) {
@@ -257,19 +442,17 @@ static int getPointArg(const char *arg1, const char *arg2, PointObject **arg) {
     if (*end != '\0')
         return throwError(ERROR_INVALID_ARG, invalidArg("y-coord", NULL));
 
-    *arg = createPointData((Point2f){x, y}, NULL, 0, NULL);
+    *arg = createPointData((Point2f){x, y}, NULL, 0, DERIVE_NONE);
     return 0;
 }
 
 static int getLineArg(const char *arg1, const char *arg2, LineObject *arg) {
-    const uint64_t id1 = strhash64(arg1);
-    const GeomObject *obj = findObjectHelper(pointSet, id1);
+    const GeomObject *obj = findObject(POINT, arg1);
     if (obj == NULL)
         return throwError(ERROR_NOT_FOUND_OBJECT, objectNotFound(arg1));
     arg->pt1 = obj->ptr->point;
 
-    const uint64_t id2 = strhash64(arg2);
-    obj = findObjectHelper(pointSet, id2);
+    obj = findObject(POINT, arg2);
     if (obj == NULL)
         return throwError(ERROR_NOT_FOUND_OBJECT, objectNotFound(arg2));
     arg->pt2 = obj->ptr->point;
@@ -278,8 +461,7 @@ static int getLineArg(const char *arg1, const char *arg2, LineObject *arg) {
 }
 
 static int getCircleArg(const char *arg1, const char *arg2, CircleObject *arg) {
-    const uint64_t id1 = strhash64(arg1);
-    const GeomObject *obj = findObjectHelper(pointSet, id1);
+    const GeomObject *obj = findObject(POINT, arg1);
     if (obj == NULL)
         return throwError(ERROR_NOT_FOUND_OBJECT, objectNotFound(arg1));
     arg->center = obj->ptr->point;
@@ -295,57 +477,29 @@ static int getCircleArg(const char *arg1, const char *arg2, CircleObject *arg) {
         return 0;
     }
 
-    const uint64_t id2 = strhash64(arg2);
-    obj = findObjectHelper(pointSet, id2);
+    obj = findObject(POINT, arg2);
     if (obj == NULL)
         return throwError(ERROR_NOT_FOUND_OBJECT, objectNotFound(arg2));
     arg->pt = obj->ptr->point;
+    arg->radius = dist2f(pointCoord(arg->center), pointCoord(arg->pt));
+    arg->version = pointVersion(arg->center) + pointVersion(arg->pt);
 
     return 0;
 }
 
-static Point2f lineCallback(PointObject **pt) {
-    const Point2f pt1 = pt[0]->coord;
-    const Vector2f vec = vec2_from_2p(pt1, pt[1]->coord);
-    const float norm = norm_vec2(vec);
-    return (Point2f){pt1.x + vec.x / norm * A_HUGE_VALF, pt1.y + vec.y / norm * A_HUGE_VALF};
-}
-
 static int getArgs(const ObjectType type, const char *arg1, const char *arg2, ObjectSelector *arg) {
-    int error;
     switch (type) {
         case POINT:
             return getPointArg(arg1, arg2, &arg->point);
         case CIRCLE:
             return getCircleArg(arg1, arg2, &arg->circle);
         default:
-            error = getLineArg(arg1, arg2, &arg->line);
-            if (error != 0)
-                return error;
-
-            LineObject *line = &arg->line;
-            PointObject *parents[2] = {line->pt1, line->pt2};
-            switch (type) {
-                case SEG:
-                    line->showPt1 = line->pt1;
-                    line->showPt2 = line->pt2;
-                    break;
-                case RAY:
-                    line->showPt1 = line->pt1;
-                    line->showPt2 = createPointData(lineCallback(parents), parents, 2, lineCallback);
-                    break;
-                default:
-                    line->showPt2 = createPointData(lineCallback(parents), parents, 2, lineCallback);
-                    parents[0] = line->pt2;
-                    parents[1] = line->pt1;
-                    line->showPt1 = createPointData(lineCallback(parents), parents, 2, lineCallback);
-            }
+            return getLineArg(arg1, arg2, &arg->line);
     }
-    return 0;
 }
 
-static int getOptionalObjectArgs(const char **argv, const char **endptr, uint64_t *id, int *show, int *rgb) {
-    *id = 0;
+static int getOptionalObjectArgs(const char **argv, const char **endptr, const char **name, int *show, int *rgb) {
+    *name = NULL;
     *show = 1;
     *rgb = -1;
     while (argv != endptr) {
@@ -354,7 +508,9 @@ static int getOptionalObjectArgs(const char **argv, const char **endptr, uint64_
             case STR_HASH64('a', 's', 0, 0, 0, 0, 0, 0):
                 if (++argv == endptr)
                     break;
-                *id = strhash64(*argv++);
+                *name = *argv++;
+                if (objectIndexFind(*name) != NULL)
+                    return throwError(ERROR_DUPLICATE_NAME, duplicateName(*name));
                 break;
 
             case STR_HASH64('-', '-', 's', 'h', 'o', 'w', 0, 0):
@@ -377,8 +533,6 @@ static int getOptionalObjectArgs(const char **argv, const char **endptr, uint64_
                 return throwError(ERROR_UNKOWN_ARG, unknownArgs(*argv));
         }
     }
-    if (*id == 0)
-        *id = getDefaultId();
     if (*rgb)
         *rgb = randomColor();
     return 0;
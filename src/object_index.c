@@ -0,0 +1,97 @@
+#include "object_index.h"
+#include "utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// open addressing, linear probing. capacity is always a power of 2
+typedef struct {
+    uint64_t hash;
+    GeomObject *obj;
+} IndexEntry;
+
+// left behind by a removal so that probe chains running through the slot stay intact
+static char tombstone;
+#define TOMBSTONE ((GeomObject *) &tombstone)
+
+static IndexEntry *entries = NULL;
+static size_t capacity = 0, count = 0, used = 0;
+
+static void rehash(const size_t newCapacity) {
+    IndexEntry *old = entries;
+    const size_t oldCapacity = capacity;
+
+    entries = calloc(newCapacity, sizeof(IndexEntry));
+    capacity = newCapacity;
+    used = count;
+
+    for (size_t i = 0; i < oldCapacity; ++i) {
+        if (old[i].obj == NULL || old[i].obj == TOMBSTONE)
+            continue;
+        size_t slot = old[i].hash & (capacity - 1);
+        while (entries[slot].obj != NULL)
+            slot = (slot + 1) & (capacity - 1);
+        entries[slot] = old[i];
+    }
+    free(old);
+}
+
+static IndexEntry *findEntry(const char *name) {
+    if (count == 0)
+        return NULL;
+
+    const uint64_t hash = hashString(name);
+    for (size_t slot = hash & (capacity - 1);; slot = (slot + 1) & (capacity - 1)) {
+        IndexEntry *entry = entries + slot;
+        if (entry->obj == NULL)
+            return NULL;
+        if (entry->obj != TOMBSTONE && entry->hash == hash && strcmp(entry->obj->name, name) == 0)
+            return entry;
+    }
+}
+
+GeomObject *objectIndexFind(const char *name) {
+    const IndexEntry *entry = findEntry(name);
+    return entry == NULL ? NULL : entry->obj;
+}
+
+// names are unique, the caller checks before inserting
+void objectIndexInsert(GeomObject *obj) {
+    // keep load factor, tombstones included, under 0.7
+    if ((used + 1) * 10 > capacity * 7)
+        rehash(capacity == 0 ? 64 : (count + 1) * 10 > capacity * 7 / 2 ? capacity * 2 : capacity);
+
+    const uint64_t hash = hashString(obj->name);
+    size_t slot = hash & (capacity - 1);
+    while (entries[slot].obj != NULL && entries[slot].obj != TOMBSTONE)
+        slot = (slot + 1) & (capacity - 1);
+
+    if (entries[slot].obj == NULL)
+        ++used;
+    entries[slot] = (IndexEntry){hash, obj};
+    ++count;
+}
+
+void objectIndexRemove(const GeomObject *obj) {
+    IndexEntry *entry = findEntry(obj->name);
+    if (entry == NULL)
+        return;
+
+    entry->obj = TOMBSTONE;
+    --count;
+}
+
+// sized once for that many more names, so a bulk insert does not rehash on the way
+void objectIndexReserve(const int more) {
+    size_t newCapacity = capacity == 0 ? 64 : capacity;
+    while ((count + (size_t) more) * 10 > newCapacity * 7 / 2)
+        newCapacity *= 2;
+    if (newCapacity != capacity)
+        rehash(newCapacity);
+}
+
+void objectIndexClear() {
+    free(entries);
+    entries = NULL;
+    capacity = count = used = 0;
+}
@@ -0,0 +1,122 @@
+#include "png_writer.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+// uncompressed (stored) deflate blocks: no zlib needed, images only come out as large as the raw pixels
+#define STORED_BLOCK_MAX 65535
+
+typedef struct {
+    FILE *file;
+    uint32_t crc;
+    uint32_t adlerA, adlerB;
+    int blockLeft; // bytes left in the current stored block
+    size_t dataLeft; // bytes left in the whole image data
+} PngStream;
+
+static uint32_t crcTable[256];
+
+static void initCrcTable() {
+    if (crcTable[1] != 0)
+        return;
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k)
+            c = c & 1 ? 0xedb88320u ^ c >> 1 : c >> 1;
+        crcTable[n] = c;
+    }
+}
+
+static void putBytes(PngStream *s, const unsigned char *bytes, const size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        s->crc = crcTable[(s->crc ^ bytes[i]) & 0xff] ^ s->crc >> 8;
+    fwrite(bytes, 1, count, s->file);
+}
+
+static void putU32(PngStream *s, const uint32_t v) {
+    const unsigned char bytes[4] = {v >> 24, v >> 16 & 0xff, v >> 8 & 0xff, v & 0xff};
+    putBytes(s, bytes, 4);
+}
+
+// the length is outside the crc, the type is inside
+static void beginChunk(PngStream *s, const char *type, const uint32_t length) {
+    const unsigned char bytes[4] = {length >> 24, length >> 16 & 0xff, length >> 8 & 0xff, length & 0xff};
+    fwrite(bytes, 1, 4, s->file);
+    s->crc = 0xffffffffu;
+    putBytes(s, (const unsigned char *) type, 4);
+}
+
+static void endChunk(PngStream *s) {
+    const uint32_t crc = s->crc ^ 0xffffffffu;
+    const unsigned char bytes[4] = {crc >> 24, crc >> 16 & 0xff, crc >> 8 & 0xff, crc & 0xff};
+    fwrite(bytes, 1, 4, s->file);
+}
+
+// image data, split into stored blocks as it goes
+static void putData(PngStream *s, const unsigned char *bytes, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        s->adlerA = (s->adlerA + bytes[i]) % 65521;
+        s->adlerB = (s->adlerB + s->adlerA) % 65521;
+    }
+
+    while (count != 0) {
+        if (s->blockLeft == 0) {
+            const int length = s->dataLeft > STORED_BLOCK_MAX ? STORED_BLOCK_MAX : (int) s->dataLeft;
+            const int nlength = 0xffff ^ length;
+            // the last block carries the final bit
+            const unsigned char header[5] = {
+                s->dataLeft == (size_t) length, length & 0xff, length >> 8, nlength & 0xff, nlength >> 8
+            };
+            putBytes(s, header, 5);
+            s->blockLeft = length;
+        }
+        const size_t n = count < (size_t) s->blockLeft ? count : (size_t) s->blockLeft;
+        putBytes(s, bytes, n);
+        bytes += n;
+        count -= n;
+        s->blockLeft -= (int) n;
+        s->dataLeft -= n;
+    }
+}
+
+int writePng(const char *filename, const unsigned char *rgb, const int width, const int height) {
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL)
+        return 1;
+
+    initCrcTable();
+    PngStream s = {file, 0, 1, 0, 0, 0};
+    fwrite(signature, 1, 8, file);
+
+    // 8 bit depth, truecolor, no interlace
+    const unsigned char ihdr[5] = {8, 2, 0, 0, 0};
+    beginChunk(&s, "IHDR", 13);
+    putU32(&s, width);
+    putU32(&s, height);
+    putBytes(&s, ihdr, 5);
+    endChunk(&s);
+
+    // each row starts with filter type 0
+    const size_t rowBytes = (size_t) width * 3;
+    s.dataLeft = (rowBytes + 1) * height;
+    const size_t blocks = (s.dataLeft + STORED_BLOCK_MAX - 1) / STORED_BLOCK_MAX;
+    const unsigned char zlibHeader[2] = {0x78, 0x01}, filter = 0;
+
+    beginChunk(&s, "IDAT", (uint32_t) (2 + 5 * blocks + s.dataLeft + 4));
+    putBytes(&s, zlibHeader, 2);
+    for (int y = 0; y < height; ++y) {
+        putData(&s, &filter, 1);
+        putData(&s, rgb + rowBytes * y, rowBytes);
+    }
+    putU32(&s, s.adlerB << 16 | s.adlerA);
+    endChunk(&s);
+
+    beginChunk(&s, "IEND", 0);
+    endChunk(&s);
+
+    const int error = ferror(file);
+    fclose(file);
+    return error;
+}
@@ -0,0 +1,291 @@
+#include "point_import.h"
+#include "board.h"
+#include "geom_errors.h"
+#include "mapped_file.h"
+#include "object.h"
+#include "object_index.h"
+#include "utils.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define CHUNK_BYTES (1 << 18) // a CSV is cut into pieces of about this size, parsed in parallel
+#define FIELD_SIZE 64
+
+typedef struct {
+    float x, y;
+    int color; // -1 for a random one
+    int line;
+    size_t name, nameLength; // where the name sits in the file, 0 long for a default one
+} ImportedPoint;
+
+// a piece of the CSV, cut right after a line end
+typedef struct {
+    size_t begin, end;
+    int firstLine, countLines;
+    int firstRow, countRows;
+    int errorLine; // the first bad line in the piece, 0 if none
+    const char *errorField; // NULL for a line with too many or too few fields
+} CsvChunk;
+
+static inline int isBlank(const char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char *lineEnd(const char *at, const char *end) {
+    const char *newline = memchr(at, '\n', end - at);
+    return newline != NULL ? newline : end;
+}
+
+// a row is any line with something other than blanks that is not a comment
+static int isRow(const char *at, const char *end) {
+    while (at != end && isBlank(*at))
+        ++at;
+    return at != end && *at != '#';
+}
+
+// [at, end) trimmed into field, NUL terminated. returns 0 if it was too long
+static int copyField(const char *at, const char *end, char *field) {
+    while (at != end && isBlank(*at))
+        ++at;
+    while (end != at && isBlank(end[-1]))
+        --end;
+    if (end - at >= FIELD_SIZE)
+        return 0;
+    memcpy(field, at, end - at);
+    field[end - at] = '\0';
+    return 1;
+}
+
+static inline int parseFloat(const char *field, float *value) {
+    char *end;
+    *value = strtof(field, &end);
+    return *field != '\0' && *end == '\0';
+}
+
+// returns the field that failed, "" for a bad field count, NULL on success.
+// the mapped file has no NUL after it, so every field is copied out before strtof sees it
+static const char *parseRow(const char *data, const char *at, const char *end, ImportedPoint *row) {
+    const char *fields[5];
+    int count = 0;
+    fields[count++] = at;
+    for (const char *c = at; c != end && count < 5; ++c)
+        if (*c == ',')
+            fields[count++] = c + 1;
+    if (count < 2 || count > 4)
+        return "";
+    fields[count] = end + 1;
+
+    char field[FIELD_SIZE];
+    if (!copyField(fields[0], fields[1] - 1, field) || !parseFloat(field, &row->x))
+        return "x-coord";
+    if (!copyField(fields[1], fields[2] - 1, field) || !parseFloat(field, &row->y))
+        return "y-coord";
+
+    row->nameLength = 0;
+    if (count >= 3) {
+        const char *name = fields[2], *nameEnd = fields[3] - 1;
+        while (name != nameEnd && isBlank(*name))
+            ++name;
+        while (nameEnd != name && isBlank(nameEnd[-1]))
+            --nameEnd;
+        row->name = name - data;
+        row->nameLength = nameEnd - name;
+    }
+
+    row->color = -1;
+    if (count == 4) {
+        char *colorEnd;
+        if (!copyField(fields[3], end, field))
+            return "color";
+        if (*field != '\0') {
+            row->color = (int) strtol(field, &colorEnd, 16);
+            if (*colorEnd != '\0')
+                return "color";
+        }
+    }
+    return NULL;
+}
+
+static void countChunk(const char *data, CsvChunk *chunk) {
+    chunk->countLines = chunk->countRows = 0;
+    for (const char *at = data + chunk->begin, *end = data + chunk->end; at < end; ++chunk->countLines) {
+        const char *next = lineEnd(at, end);
+        chunk->countRows += isRow(at, next);
+        at = next + 1;
+    }
+}
+
+static void parseChunk(const char *data, CsvChunk *chunk, ImportedPoint *rows) {
+    int line = chunk->firstLine;
+    ImportedPoint *row = rows + chunk->firstRow;
+    chunk->errorLine = 0;
+    for (const char *at = data + chunk->begin, *end = data + chunk->end; at < end; ++line) {
+        const char *next = lineEnd(at, end);
+        if (isRow(at, next)) {
+            const char *field = parseRow(data, at, next, row);
+            if (field != NULL) {
+                chunk->errorLine = line;
+                chunk->errorField = *field != '\0' ? field : NULL;
+                return;
+            }
+            row++->line = line;
+        }
+        at = next + 1;
+    }
+}
+
+// the pieces are counted, then parsed straight into their place in rows, both on as many threads as
+// `threads` gives propagation
+static int parseCsv(const MappedFile *file, ImportedPoint **rows, int *countRows) {
+#ifdef _OPENMP
+    const int threads = getPropagationThreads() > 0 ? getPropagationThreads() : omp_get_max_threads();
+#endif
+    const int countChunks = (int) (file->size / CHUNK_BYTES) + 1;
+    CsvChunk *chunks = malloc(sizeof(CsvChunk) * countChunks);
+    size_t begin = 0;
+    for (int i = 0; i < countChunks; ++i) {
+        size_t end = i == countChunks - 1 ? file->size : (size_t) (i + 1) * CHUNK_BYTES;
+        if (end < begin)
+            end = begin;
+        const char *newline = end < file->size ? memchr(file->data + end, '\n', file->size - end) : NULL;
+        if (end < file->size)
+            end = newline != NULL ? (size_t) (newline - file->data) + 1 : file->size;
+        chunks[i].begin = begin;
+        chunks[i].end = begin = end;
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(dynamic)
+#endif
+    for (int i = 0; i < countChunks; ++i)
+        countChunk(file->data, chunks + i);
+
+    // lines are counted as size_t first, a row number may not overflow before it is checked
+    size_t lines = 1, total = 0;
+    for (int i = 0; i < countChunks; ++i) {
+        chunks[i].firstLine = (int) lines;
+        chunks[i].firstRow = (int) total;
+        lines += chunks[i].countLines;
+        total += chunks[i].countRows;
+    }
+    if (lines > INT_MAX) {
+        free(chunks);
+        return throwError(ERROR_INVALID_ARG, invalidArg("file", "Too many lines"));
+    }
+    *countRows = (int) total;
+    *rows = malloc(sizeof(ImportedPoint) * (total ? total : 1));
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(dynamic)
+#endif
+    for (int i = 0; i < countChunks; ++i)
+        parseChunk(file->data, chunks + i, *rows);
+
+    // the pieces are in file order, the first one to fail has the first bad line
+    int error = 0;
+    for (int i = 0; i < countChunks && error == 0; ++i) {
+        if (chunks[i].errorLine == 0)
+            continue;
+        const char *text = chunks[i].errorField == NULL
+                               ? "Please give x,y[,name[,color]]"
+                               : strcmp(chunks[i].errorField, "color") == 0
+                                     ? invalidColor()
+                                     : invalidArg(chunks[i].errorField, NULL);
+        error = throwError(ERROR_INVALID_ARG, errorInline(text, chunks[i].errorLine));
+    }
+    free(chunks);
+    return error;
+}
+
+static int readRaw(const MappedFile *file, ImportedPoint **rows, int *countRows) {
+    if (file->size % (sizeof(float) * 2) != 0)
+        return throwError(ERROR_INVALID_ARG, invalidArg("file", "Raw points are float32 x, y pairs"));
+
+    const size_t count = file->size / (sizeof(float) * 2);
+    if (count > INT_MAX)
+        return throwError(ERROR_INVALID_ARG, invalidArg("file", "Too many points"));
+    *countRows = (int) count;
+    *rows = malloc(sizeof(ImportedPoint) * (count ? count : 1));
+    const float *coords = (const float *) file->data;
+    for (size_t i = 0; i < count; ++i)
+        (*rows)[i] = (ImportedPoint){coords[2 * i], coords[2 * i + 1], -1, 0, 0, 0};
+    return 0;
+}
+
+// one after another, since names are checked against those already in. storage is taken in one go
+static int insertPoints(const char *data, const ImportedPoint *rows, const int count) {
+    static char *name = NULL;
+    static size_t nameCapacity = 0;
+
+    if (count <= 0)
+        return 0;
+    const int countByParents[MAX_PARENTS + 1] = {count};
+    reservePointData(countByParents, count);
+    reserveGeomObjects(count, 0, 0);
+    GeomObject **created = malloc(sizeof(GeomObject *) * (size_t) count);
+
+    for (int i = 0; i < count; ++i) {
+        const ImportedPoint *row = rows + i;
+        if (row->nameLength != 0) {
+            if (nameCapacity < row->nameLength + 1)
+                name = realloc(name, nameCapacity = row->nameLength * 2 + 1);
+            memcpy(name, data + row->name, row->nameLength);
+            name[row->nameLength] = '\0';
+
+            if (objectIndexFind(name) != NULL) {
+                while (i != 0)
+                    deleteObject(created[--i]);
+                free(created);
+                return throwError(ERROR_DUPLICATE_NAME, errorInline(duplicateName(name), row->line));
+            }
+        }
+
+        PointObject *pt = createPointData((Point2f){row->x, row->y}, NULL, 0, DERIVE_NONE);
+        created[i] = createGeomObject(POINT, (ObjectSelector *) &pt, row->nameLength != 0 ? name : NULL, 1,
+                                      row->color >= 0 ? row->color : randomColor());
+    }
+    free(created);
+    return 0;
+}
+
+int import_points(const int argc, const char **argv) {
+    static char summary[48];
+
+    const char *filename = NULL;
+    int raw = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--raw") == 0)
+            raw = 1;
+        else
+            filename = argv[i];
+    }
+    if (filename == NULL)
+        return throwError(ERROR_NO_ARG_GIVEN, noArgGiven(*argv));
+
+    MappedFile file;
+    if (mapFile(filename, &file) != 0)
+        return throwError(ERROR_CANNOT_OPEN_FILE, cannotOpenFileError(filename));
+
+    const double start = getTimeMs();
+    ImportedPoint *rows = NULL;
+    int count = 0;
+    int error = raw ? readRaw(&file, &rows, &count) : parseCsv(&file, &rows, &count);
+    if (error == 0)
+        error = insertPoints(file.data, rows, count);
+    const double elapsed = getTimeMs() - start;
+
+    free(rows);
+    unmapFile(&file);
+    if (error != 0)
+        return error;
+
+    refreshBoard();
+    snprintf(summary, sizeof(summary), "%d points in %.1f ms", count, elapsed);
+    return showMessage(summary);
+}
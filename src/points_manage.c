@@ -1,30 +1,114 @@
 #include "points_manage.h"
+#include "derive.h"
+#include "slab.h"
+#include "utils.h"
 
-#define QUEUE_ELEMENT_TYPE PointObject *
-#include "queue.h"
+#include <stdlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
-static PointObject *pointDataSet = NULL;
-static int pointDataCount = 0;
+#define PLAN_CACHE_SIZE 4
+#define MAX_PLAN_SOURCES 16
 
-PointObject *createPointData(const Point2f pt, PointObject **parents, const int numParents,
-                             Point2f (*derive)(PointObject **)) {
-    PointObject *obj = malloc(sizeof(PointObject) + sizeof(PointObject *) * numParents);
-    obj->next = pointDataSet;
-    pointDataSet = obj;
+// the order in which a move of the same sources propagates, valid while the topology is unchanged.
+// points in [levelStart[i], levelStart[i + 1]) only depend on earlier levels
+typedef struct {
+    unsigned topology;
+    int countSources;
+    PointObject *sources[MAX_PLAN_SOURCES];
+    PointObject **order;
+    int length, capacity;
+    int *levelStart;
+    int levels, levelCapacity;
+    DeriveTape tape;
+} PropagationPlan;
 
-    obj->coord = pt;
+// one slab per parent count, so every record in a chunk has the same size
+static Slab pointSlabs[MAX_PARENTS + 1] = {
+    SLAB_INITIALIZER("point", sizeof(PointObject), 1024),
+    SLAB_INITIALIZER("point/1", sizeof(PointObject) + sizeof(PointObject *), 1024),
+    SLAB_INITIALIZER("point/2", sizeof(PointObject) + sizeof(PointObject *) * 2, 1024)
+};
+static Slab subPointSlab = SLAB_INITIALIZER("edge", sizeof(SubPoint), 2048);
+static Slab userSlab = SLAB_INITIALIZER("user", sizeof(ObjectLink), 2048);
+
+PointCoords pointCoords = {NULL, NULL, NULL, 0, 0};
+
+// per index slot, parallel to pointCoords
+static unsigned *generations = NULL;
+static PointObject **owners = NULL;
+static int *freeIndices = NULL;
+static int freeCount = 0;
+
+static PropagationPlan planCache[PLAN_CACHE_SIZE];
+static const PropagationPlan *lastPlan = NULL;
+static double lastMoveMs = 0;
+static unsigned topologyVersion = 1;
+static int lazyEvaluation = 0;
+static int propagationThreads = 0;
+
+static void topologyChanged();
+
+static void growPointCoords(const int capacity) {
+    const int oldCapacity = pointCoords.capacity;
+    pointCoords.capacity = capacity;
+    pointCoords.x = realloc(pointCoords.x, sizeof(float) * pointCoords.capacity);
+    pointCoords.y = realloc(pointCoords.y, sizeof(float) * pointCoords.capacity);
+    pointCoords.version = realloc(pointCoords.version, sizeof(unsigned) * pointCoords.capacity);
+    owners = realloc(owners, sizeof(PointObject *) * pointCoords.capacity);
+    freeIndices = realloc(freeIndices, sizeof(int) * pointCoords.capacity);
+    generations = realloc(generations, sizeof(unsigned) * pointCoords.capacity);
+    for (int i = oldCapacity; i < pointCoords.capacity; ++i)
+        generations[i] = pointCoords.version[i] = 0;
+}
+
+static int newPointIndex() {
+    if (freeCount != 0)
+        return freeIndices[--freeCount];
+
+    if (pointCoords.count == pointCoords.capacity)
+        growPointCoords(pointCoords.capacity == 0 ? 1024 : pointCoords.capacity * 2);
+    return pointCoords.count++;
+}
+
+// room for countByParents[n] more points with n parents each and countUsers more object links,
+// allocated up front rather than chunk by chunk
+void reservePointData(const int *countByParents, const int countUsers) {
+    int count = 0, countEdges = 0;
+    for (int i = 0; i <= MAX_PARENTS; ++i) {
+        slabReserve(pointSlabs + i, countByParents[i]);
+        count += countByParents[i];
+        countEdges += countByParents[i] * i;
+    }
+    slabReserve(&subPointSlab, countEdges);
+    slabReserve(&userSlab, countUsers);
+
+    if (pointCoords.count + count > pointCoords.capacity)
+        growPointCoords(pointCoords.count + count);
+}
+
+PointObject *createPointData(const Point2f pt, PointObject **parents, const int numParents, const DeriveOp op) {
+    PointObject *obj = slabAlloc(pointSlabs + numParents);
+
+    obj->index = newPointIndex();
     obj->indegree = 0;
+    obj->numParents = numParents;
+    obj->flags = 0;
     obj->children = NULL;
-    obj->derive = derive;
-
-    pointDataCount++;
+    obj->users = NULL;
+    obj->op = op;
+    setPointCoord(obj, pt);
+    owners[obj->index] = obj;
 
     if (numParents == 0)
         return obj;
 
+    topologyChanged();
+
     for (int i = 0; i < numParents; ++i) {
         PointObject *parent = parents[i];
-        SubPoint *subpt = malloc(sizeof(SubPoint));
+        SubPoint *subpt = slabAlloc(&subPointSlab);
 
         *subpt = (SubPoint){obj, parent->children};
         parent->children = subpt;
@@ -34,40 +118,290 @@ PointObject *createPointData(const Point2f pt, PointObject **parents, const int
     return obj;
 }
 
-static void initIndegree(Queue *queue) {
-    const int count = queue->size;
-    while (queue->size) {
-        const PointObject *pt = dequeue(queue);
-        for (const SubPoint *subpt = pt->children; subpt; subpt = subpt->next) {
+void addPointUser(PointObject *pt, struct GeomObject_ *obj) {
+    ObjectLink *link = slabAlloc(&userSlab);
+    *link = (ObjectLink){obj, pt->users};
+    pt->users = link;
+}
+
+void removePointUser(PointObject *pt, const struct GeomObject_ *obj) {
+    for (ObjectLink **link = &pt->users; *link != NULL; link = &(*link)->next) {
+        if ((*link)->obj == obj) {
+            ObjectLink *found = *link;
+            *link = found->next;
+            slabFree(&userSlab, found);
+            return;
+        }
+    }
+}
+
+// root and everything derived from it, each tagged POINT_MARKED.
+// the array is reused by the next call
+int collectDescendants(PointObject *root, PointObject ***descendants) {
+    static PointObject **found = NULL;
+    static int capacity = 0;
+
+    if (capacity < pointCoords.count) {
+        capacity = pointCoords.capacity;
+        found = realloc(found, sizeof(PointObject *) * capacity);
+    }
+
+    int count = 0;
+    root->flags |= POINT_MARKED;
+    found[count++] = root;
+    for (int i = 0; i < count; ++i) {
+        for (const SubPoint *subpt = found[i]->children; subpt; subpt = subpt->next) {
+            PointObject *child = subpt->pt;
+            if (child->flags & POINT_MARKED)
+                continue;
+            child->flags |= POINT_MARKED;
+            found[count++] = child;
+        }
+    }
+
+    *descendants = found;
+    return count;
+}
+
+// parents that are marked are going away as well, so their lists are left alone
+void destroyPointData(PointObject *pt) {
+    for (int i = 0; i < pt->numParents; ++i) {
+        PointObject *parent = pt->parents[i];
+        if (parent->flags & POINT_MARKED)
+            continue;
+
+        for (SubPoint **subpt = &parent->children; *subpt != NULL; subpt = &(*subpt)->next) {
+            if ((*subpt)->pt == pt) {
+                SubPoint *found = *subpt;
+                *subpt = found->next;
+                slabFree(&subPointSlab, found);
+                break;
+            }
+        }
+    }
+
+    for (SubPoint *subpt = pt->children; subpt != NULL;) {
+        SubPoint *next = subpt->next;
+        slabFree(&subPointSlab, subpt);
+        subpt = next;
+    }
+
+    for (ObjectLink *link = pt->users; link != NULL;) {
+        ObjectLink *next = link->next;
+        slabFree(&userSlab, link);
+        link = next;
+    }
+
+    topologyChanged();
+    ++generations[pt->index];
+    owners[pt->index] = NULL;
+    freeIndices[freeCount++] = pt->index;
+    slabFree(pointSlabs + pt->numParents, pt);
+}
+
+PointHandle getPointHandle(const PointObject *pt) {
+    return (PointHandle){pt->index, generations[pt->index]};
+}
+
+PointObject *resolvePointHandle(const PointHandle handle) {
+    if (handle.index < 0 || handle.index >= pointCoords.count || generations[handle.index] != handle.generation)
+        return NULL;
+    return owners[handle.index];
+}
+
+// a new edge may add nodes to a cached order, a removed point leaves dangling ones
+static void topologyChanged() {
+    if (++topologyVersion == 0)
+        ++topologyVersion;
+}
+
+static void reserve(PointObject ***array, int *capacity, const int size) {
+    if (*capacity >= size)
+        return;
+    *capacity = size;
+    *array = realloc(*array, sizeof(PointObject *) * size);
+}
+
+// kahn's algorithm over the subgraph reachable from the sources
+static void buildPlan(PropagationPlan *plan, PointObject **pts, const int count) {
+    static PointObject **reached = NULL;
+    static int capacity = 0;
+
+    reserve(&reached, &capacity, pointCoords.count);
+    reserve(&plan->order, &plan->capacity, pointCoords.count);
+
+    int countReached = 0;
+    for (int i = 0; i < count; ++i) {
+        if (pts[i]->flags & POINT_MARKED)
+            continue;
+        pts[i]->flags |= POINT_MARKED;
+        reached[countReached++] = pts[i];
+    }
+    for (int i = 0; i < countReached; ++i) {
+        for (const SubPoint *subpt = reached[i]->children; subpt; subpt = subpt->next) {
             PointObject *child = subpt->pt;
-            if (child->indegree == 0)
-                enqueue(queue, child);
             child->indegree++;
+            if (child->flags & POINT_MARKED)
+                continue;
+            child->flags |= POINT_MARKED;
+            reached[countReached++] = child;
         }
     }
-    queue->front = 0;
-    queue->rear = count;
-    queue->size = count;
+
+    int length = 0;
+    for (int i = 0; i < countReached; ++i) {
+        reached[i]->flags &= ~POINT_MARKED;
+        if (reached[i]->indegree == 0)
+            plan->order[length++] = reached[i];
+    }
+    // one frontier at a time, so the order comes out grouped by level
+    if (plan->levelCapacity < pointCoords.count + 1) {
+        plan->levelCapacity = pointCoords.count + 1;
+        plan->levelStart = realloc(plan->levelStart, sizeof(int) * plan->levelCapacity);
+    }
+    plan->levels = 0;
+    for (int i = 0; i < length;) {
+        plan->levelStart[plan->levels++] = i;
+        for (const int end = length; i < end; ++i) {
+            for (const SubPoint *subpt = plan->order[i]->children; subpt; subpt = subpt->next) {
+                PointObject *child = subpt->pt;
+                if (--child->indegree == 0)
+                    plan->order[length++] = child;
+            }
+        }
+    }
+    plan->levelStart[plan->levels] = length;
+    plan->length = length;
+    buildTape(&plan->tape, plan->order, plan->levelStart, plan->levels);
+
+    plan->topology = count <= MAX_PLAN_SOURCES ? topologyVersion : 0;
+    plan->countSources = count;
+    for (int i = 0; i < count && i < MAX_PLAN_SOURCES; ++i)
+        plan->sources[i] = pts[i];
+}
+
+static PropagationPlan *getPlan(PointObject **pts, const int count) {
+    static int victim = 0;
+
+    for (int i = 0; i < PLAN_CACHE_SIZE; ++i) {
+        PropagationPlan *plan = planCache + i;
+        if (plan->topology != topologyVersion || plan->countSources != count)
+            continue;
+
+        int same = 1;
+        for (int j = 0; j < count && same; ++j)
+            same = plan->sources[j] == pts[j];
+        if (same)
+            return plan;
+    }
+
+    PropagationPlan *plan = planCache + victim;
+    victim = (victim + 1) % PLAN_CACHE_SIZE;
+    buildPlan(plan, pts, count);
+    return plan;
 }
 
 void movePoints(PointObject **pts, const Point2f *dst, const int count) {
-    Queue *queue = newQueue(pointDataCount);
-    for (int i = 0; i < count; ++i) {
-        pts[i]->coord = dst[i];
-        enqueue(queue, pts[i]);
+    const double start = getTimeMs();
+    for (int i = 0; i < count; ++i)
+        setPointCoord(pts[i], dst[i]);
+
+    const PropagationPlan *plan = lastPlan = getPlan(pts, count);
+    if (lazyEvaluation) {
+        for (int i = 0; i < plan->length; ++i)
+            if (plan->order[i]->op != DERIVE_NONE)
+                plan->order[i]->flags |= POINT_DIRTY;
+    } else {
+        // nothing is dirty in eager mode, so the tape can read the coordinates directly
+        runTape(&plan->tape, propagationThreads);
     }
+    lastMoveMs = getTimeMs() - start;
+}
 
-    initIndegree(queue);
-    while(queue->size) {
-        PointObject *pt = dequeue(queue);
-        if(pt->derive != NULL)
-            pt->coord = pt->derive(pt->parents);
+// plan lookup and propagation, in lazy mode only the marking
+double getLastMoveMs() {
+    return lastMoveMs;
+}
 
-        for (const SubPoint *subpt = pt->children; subpt; subpt = subpt->next) {
-            PointObject *child = subpt->pt;
-            if (--child->indegree == 0)
-                enqueue(queue, child);
+// the sources of the last move and everything that followed them
+int getLastMoved(PointObject *const **moved) {
+    if (lastPlan == NULL || lastPlan->topology != topologyVersion) {
+        *moved = NULL;
+        return 0;
+    }
+    *moved = lastPlan->order;
+    return lastPlan->length;
+}
+
+// depth first through the dirty ancestors, without recursion so long chains are fine
+void resolvePoint(PointObject *pt) {
+    static PointObject **stack = NULL;
+    static int capacity = 0;
+
+    int size = 0;
+    reserve(&stack, &capacity, 64);
+    stack[size++] = pt;
+    while (size != 0) {
+        PointObject *top = stack[size - 1];
+        if (!(top->flags & POINT_DIRTY)) {
+            --size;
+            continue;
+        }
+
+        int ready = 1;
+        for (int i = 0; i < top->numParents; ++i) {
+            if (top->parents[i]->flags & POINT_DIRTY) {
+                reserve(&stack, &capacity, size < capacity ? capacity : capacity * 2);
+                stack[size++] = top->parents[i];
+                ready = 0;
+            }
         }
+        if (!ready)
+            continue;
+
+        setPointCoord(top, deriveCoord(top->op, top->parents));
+        --size;
     }
-    queue_destroy(queue);
+}
+
+// eager propagation may run on several threads and relies on there being no dirty point left
+void setLazyEvaluation(const int lazy) {
+    lazyEvaluation = lazy;
+    if (lazy)
+        return;
+
+    for (int i = 0; i < pointCoords.count; ++i)
+        if (owners[i] != NULL && owners[i]->flags & POINT_DIRTY)
+            resolvePoint(owners[i]);
+}
+
+// 0 leaves it to OpenMP
+void setPropagationThreads(const int threads) {
+    propagationThreads = threads;
+}
+
+int getPropagationThreads() {
+    return propagationThreads;
+}
+
+int getMaxThreads() {
+#ifdef _OPENMP
+    return omp_get_num_procs();
+#else
+    return 1;
+#endif
+}
+
+void clearPointData() {
+    for (int i = 0; i <= MAX_PARENTS; ++i)
+        slabRelease(pointSlabs + i);
+    slabRelease(&subPointSlab);
+    slabRelease(&userSlab);
+
+    // outstanding handles must not resolve to whatever reuses the slot
+    for (int i = 0; i < pointCoords.count; ++i)
+        ++generations[i];
+    pointCoords.count = 0;
+    freeCount = 0;
+    topologyChanged();
 }
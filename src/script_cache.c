@@ -0,0 +1,474 @@
+#include "script_cache.h"
+#include "board.h"
+#include "derive.h"
+#include "draw_batch.h"
+#include "geom_errors.h"
+#include "geom_utils.h"
+#include "mapped_file.h"
+#include "object_index.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_MAGIC 0x43424747u // "GGBC"
+#define CACHE_VERSION 1
+#define MAX_MOVED 16 // as many as move-pt takes
+
+typedef enum {
+    OP_POINT,
+    OP_MIDPOINT,
+    OP_LINE,
+    OP_RAY,
+    OP_SEG,
+    OP_CIRCLE,
+    OP_CIRCLE_RADIUS,
+    OP_MOVE,
+    OP_SHOW,
+    OP_DELETE,
+    OP_LAZY,
+    OP_THREADS,
+    OP_REFRESH,
+    OP_COUNT
+} ScriptOp;
+
+// the ops follow back to back. each starts with its code (1 byte) and script line (4 bytes). objects
+// are 4 byte creation indices, names a 4 byte length, 0 for a default name, then the bytes. a creation
+// carries its name, show (1 byte) and color (4 bytes) before its own operands
+typedef struct {
+    uint32_t magic, version;
+    uint64_t hash;
+    uint32_t countObjects, countOps;
+} CacheHeader;
+
+// recording
+
+static int recording = 0, spoiled = 0;
+static unsigned char *ops = NULL;
+static size_t opsSize = 0, opsCapacity = 0;
+static int recordingLine = 0, countOps = 0, countObjects = 0;
+static unsigned firstSerial = 0;
+
+static inline int isRecording() {
+    return recording && !spoiled;
+}
+
+static void put(const void *bytes, const size_t count) {
+    if (opsSize + count > opsCapacity) {
+        opsCapacity = opsCapacity ? opsCapacity * 2 : 4096;
+        if (opsCapacity < opsSize + count)
+            opsCapacity = opsSize + count;
+        ops = realloc(ops, opsCapacity);
+    }
+    memcpy(ops + opsSize, bytes, count);
+    opsSize += count;
+}
+
+static inline void putU8(const uint8_t value) {
+    put(&value, 1);
+}
+
+static inline void putU32(const uint32_t value) {
+    put(&value, 4);
+}
+
+static inline void putF32(const float value) {
+    put(&value, 4);
+}
+
+static void beginOp(const ScriptOp op) {
+    putU8(op);
+    putU32(recordingLine);
+    ++countOps;
+}
+
+// objects from before the script have no index, the script is then left uncached
+static void putObject(const GeomObject *obj) {
+    if (obj == NULL || countObjects == 0 || obj->serial < firstSerial || obj->serial - firstSerial >= (unsigned) countObjects) {
+        spoiled = 1;
+        return;
+    }
+    putU32(obj->serial - firstSerial);
+}
+
+// the point object a point belongs to
+static const GeomObject *pointOwner(const PointObject *pt) {
+    for (const ObjectLink *link = pt->users; link != NULL; link = link->next)
+        if (link->obj->type == POINT && link->obj->ptr->point == pt)
+            return link->obj;
+    return NULL;
+}
+
+static void putCreation(const ScriptOp op, const GeomObject *obj, const int defaultName) {
+    beginOp(op);
+    const uint32_t length = defaultName ? 0 : (uint32_t) strlen(obj->name);
+    putU32(length);
+    put(obj->name, length);
+    putU8(obj->show != 0);
+    putU32(obj->color);
+}
+
+int beginRecording() {
+    if (recording)
+        return 0;
+    recording = 1;
+    spoiled = 0;
+    opsSize = 0;
+    countOps = countObjects = 0;
+    return 1;
+}
+
+void endRecording(const char *cacheName, const uint64_t hash, const int succeeded) {
+    recording = 0;
+    if (!succeeded || spoiled)
+        return;
+
+    FILE *file = fopen(cacheName, "wb");
+    if (file == NULL)
+        return;
+    const CacheHeader header = {CACHE_MAGIC, CACHE_VERSION, hash, countObjects, countOps};
+    const int written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                        (opsSize == 0 || fwrite(ops, opsSize, 1, file) == 1);
+    // a cache that is only half there must not be found next time
+    if (fclose(file) != 0 || !written)
+        remove(cacheName);
+}
+
+void recordCommand(const char *command, const int line) {
+    if (!isRecording())
+        return;
+    recordingLine = line;
+    switch (strhash64(command)) {
+        case STR_HASH64('c', 'r', 'e', 'a', 't', 'e', 0, 0):
+        case STR_HASH64('m', 'i', 'd', 'p', 'o', 'i', 'n', 't'):
+        case STR_HASH64('m', 'o', 'v', 'e', '-', 'p', 't', 0):
+        case STR_HASH64('d', 'e', 'l', 'e', 't', 'e', 0, 0):
+        case STR_HASH64('s', 'h', 'o', 'w', 0, 0, 0, 0):
+        case STR_HASH64('h', 'i', 'd', 'e', 0, 0, 0, 0):
+        case STR_HASH64('l', 'a', 'z', 'y', 0, 0, 0, 0):
+        case STR_HASH64('t', 'h', 'r', 'e', 'a', 'd', 's', 0):
+        case STR_HASH64('r', 'e', 'f', 'r', 'e', 's', 'h', 0):
+            return;
+        default:
+            spoiled = 1;
+    }
+}
+
+void recordCreate(const GeomObject *obj, const int defaultName) {
+    if (!isRecording())
+        return;
+    if (countObjects == 0)
+        firstSerial = obj->serial;
+    if (obj->serial != firstSerial + countObjects) {
+        spoiled = 1;
+        return;
+    }
+    ++countObjects;
+
+    const PointObject *pt;
+    switch (obj->type) {
+        case POINT:
+            pt = obj->ptr->point;
+            if (pt->numParents == 0) {
+                const Point2f p = pointCoord(pt);
+                putCreation(OP_POINT, obj, defaultName);
+                putF32(p.x);
+                putF32(p.y);
+            } else if (pt->op == DERIVE_MIDPOINT) {
+                putCreation(OP_MIDPOINT, obj, defaultName);
+                putObject(pointOwner(pt->parents[0]));
+                putObject(pointOwner(pt->parents[1]));
+            } else {
+                spoiled = 1;
+            }
+            return;
+        case CIRCLE:
+            if (obj->ptr->circle.pt == NULL) {
+                putCreation(OP_CIRCLE_RADIUS, obj, defaultName);
+                putObject(pointOwner(obj->ptr->circle.center));
+                putF32(obj->ptr->circle.radius);
+            } else {
+                putCreation(OP_CIRCLE, obj, defaultName);
+                putObject(pointOwner(obj->ptr->circle.center));
+                putObject(pointOwner(obj->ptr->circle.pt));
+            }
+            return;
+        default:
+            putCreation(obj->type == LINE ? OP_LINE : obj->type == RAY ? OP_RAY : OP_SEG, obj, defaultName);
+            putObject(pointOwner(obj->ptr->line.pt1));
+            putObject(pointOwner(obj->ptr->line.pt2));
+    }
+}
+
+void recordMove(GeomObject *const *src, GeomObject *const *dst, const int count) {
+    if (!isRecording())
+        return;
+    beginOp(OP_MOVE);
+    putU32(count);
+    for (int i = 0; i < count; ++i)
+        putObject(src[i]);
+    for (int i = 0; i < count; ++i)
+        putObject(dst[i]);
+}
+
+void recordShow(const GeomObject *obj) {
+    if (!isRecording())
+        return;
+    beginOp(OP_SHOW);
+    putObject(obj);
+    putU8(obj->show != 0);
+    putU32(obj->color);
+}
+
+void recordDelete(const GeomObject *obj) {
+    if (!isRecording())
+        return;
+    beginOp(OP_DELETE);
+    putObject(obj);
+}
+
+void recordLazy(const int lazy) {
+    if (!isRecording())
+        return;
+    beginOp(OP_LAZY);
+    putU8(lazy != 0);
+}
+
+void recordThreads(const int threads) {
+    if (!isRecording())
+        return;
+    beginOp(OP_THREADS);
+    putU32(threads);
+}
+
+void recordRefresh() {
+    if (!isRecording())
+        return;
+    beginOp(OP_REFRESH);
+}
+
+// replaying
+
+typedef struct {
+    const unsigned char *at, *end;
+    int broken;
+} OpReader;
+
+static void take(OpReader *reader, void *bytes, const size_t count) {
+    if (reader->broken || (size_t) (reader->end - reader->at) < count) {
+        reader->broken = 1;
+        memset(bytes, 0, count);
+        return;
+    }
+    memcpy(bytes, reader->at, count);
+    reader->at += count;
+}
+
+static inline uint32_t takeU32(OpReader *reader) {
+    uint32_t value;
+    take(reader, &value, 4);
+    return value;
+}
+
+static inline uint8_t takeU8(OpReader *reader) {
+    uint8_t value;
+    take(reader, &value, 1);
+    return value;
+}
+
+static inline float takeF32(OpReader *reader) {
+    float value;
+    take(reader, &value, 4);
+    return value;
+}
+
+// an index of an object created further up, or -1
+static inline int takeObject(OpReader *reader, const int created) {
+    const uint32_t index = takeU32(reader);
+    if (index >= (uint32_t) created)
+        reader->broken = 1;
+    return reader->broken ? -1 : (int) index;
+}
+
+typedef struct {
+    const char *name; // NULL for a default one
+    int show, color;
+} Creation;
+
+static Creation takeCreation(OpReader *reader) {
+    static char *name = NULL;
+    static uint32_t capacity = 0;
+
+    const uint32_t length = takeU32(reader);
+    if (reader->broken || (size_t) (reader->end - reader->at) < length) {
+        reader->broken = 1;
+        return (Creation){NULL, 0, 0};
+    }
+    if (length + 1 > capacity)
+        name = realloc(name, capacity = length + 1);
+    take(reader, name, length);
+    name[length] = '\0';
+
+    Creation creation;
+    creation.name = length != 0 ? name : NULL;
+    creation.show = takeU8(reader);
+    creation.color = (int) takeU32(reader);
+    return creation;
+}
+
+// runs every op when objects is given, otherwise only checks the whole stream reads back.
+// returns what the failing op returned, 0 if none failed
+static int runOps(OpReader reader, const uint32_t count, GeomObject **objects, int *created, int *line) {
+    const int execute = objects != NULL;
+    ObjectSelector arg;
+    Creation creation = {NULL, 0, 0};
+    PointObject *pts[MAX_MOVED];
+    Point2f dst[MAX_MOVED];
+    int a, b;
+
+    *created = 0;
+    for (uint32_t i = 0; i < count && !reader.broken; ++i) {
+        const ScriptOp op = takeU8(&reader);
+        *line = (int) takeU32(&reader);
+
+        if (op <= OP_CIRCLE_RADIUS) {
+            creation = takeCreation(&reader);
+            if (execute && creation.name != NULL && objectIndexFind(creation.name) != NULL)
+                return throwError(ERROR_DUPLICATE_NAME, duplicateName(creation.name));
+        }
+
+        switch (op) {
+            case OP_POINT: {
+                const float x = takeF32(&reader), y = takeF32(&reader);
+                if (execute && !reader.broken)
+                    arg.point = createPointData((Point2f){x, y}, NULL, 0, DERIVE_NONE);
+                break;
+            }
+            case OP_MIDPOINT:
+                a = takeObject(&reader, *created);
+                b = takeObject(&reader, *created);
+                if (execute && !reader.broken) {
+                    PointObject *parents[2] = {objects[a]->ptr->point, objects[b]->ptr->point};
+                    arg.point = createPointData(deriveCoord(DERIVE_MIDPOINT, parents), parents, 2, DERIVE_MIDPOINT);
+                }
+                break;
+            case OP_LINE:
+            case OP_RAY:
+            case OP_SEG:
+                a = takeObject(&reader, *created);
+                b = takeObject(&reader, *created);
+                if (execute && !reader.broken)
+                    arg.line = (LineObject){objects[a]->ptr->point, objects[b]->ptr->point};
+                break;
+            case OP_CIRCLE:
+                a = takeObject(&reader, *created);
+                b = takeObject(&reader, *created);
+                if (execute && !reader.broken) {
+                    arg.circle.center = objects[a]->ptr->point;
+                    arg.circle.pt = objects[b]->ptr->point;
+                    arg.circle.radius = dist2f(pointCoord(arg.circle.center), pointCoord(arg.circle.pt));
+                    arg.circle.version = pointVersion(arg.circle.center) + pointVersion(arg.circle.pt);
+                }
+                break;
+            case OP_CIRCLE_RADIUS:
+                a = takeObject(&reader, *created);
+                arg.circle.radius = takeF32(&reader);
+                if (execute && !reader.broken) {
+                    arg.circle.center = objects[a]->ptr->point;
+                    arg.circle.pt = NULL;
+                }
+                break;
+            case OP_MOVE: {
+                const uint32_t moved = takeU32(&reader);
+                if (moved == 0 || moved > MAX_MOVED) {
+                    reader.broken = 1;
+                    break;
+                }
+                for (uint32_t j = 0; j < moved; ++j)
+                    if ((a = takeObject(&reader, *created)) >= 0 && execute)
+                        pts[j] = objects[a]->ptr->point;
+                for (uint32_t j = 0; j < moved; ++j)
+                    if ((a = takeObject(&reader, *created)) >= 0 && execute)
+                        dst[j] = pointCoord(objects[a]->ptr->point);
+                if (execute && !reader.broken) {
+                    movePoints(pts, dst, (int) moved);
+                    markPointsMoved();
+                }
+                break;
+            }
+            case OP_SHOW: {
+                a = takeObject(&reader, *created);
+                const int show = takeU8(&reader), color = (int) takeU32(&reader);
+                if (execute && !reader.broken) {
+                    objects[a]->show = show;
+                    objects[a]->color = color;
+                    markObjectChanged(objects[a]);
+                }
+                break;
+            }
+            case OP_DELETE:
+                a = takeObject(&reader, *created);
+                if (execute && !reader.broken)
+                    deleteObject(objects[a]);
+                break;
+            case OP_LAZY: {
+                const int lazy = takeU8(&reader);
+                if (execute && !reader.broken)
+                    setLazyEvaluation(lazy);
+                break;
+            }
+            case OP_THREADS: {
+                const int threads = (int) takeU32(&reader);
+                if (execute && !reader.broken) {
+                    setPropagationThreads(threads);
+                    setRasterThreads(threads);
+                }
+                break;
+            }
+            case OP_REFRESH:
+                if (execute)
+                    presentBoard();
+                break;
+            default:
+                reader.broken = 1;
+        }
+
+        if (op <= OP_CIRCLE_RADIUS && !reader.broken) {
+            const ObjectType types[] = {POINT, POINT, LINE, RAY, SEG, CIRCLE, CIRCLE};
+            if (execute)
+                objects[*created] = createGeomObject(types[op], &arg, creation.name, creation.show, creation.color);
+            ++*created;
+        }
+    }
+    return reader.broken ? -1 : 0;
+}
+
+int replayCache(const char *cacheName, const uint64_t hash, int *error, int *line) {
+    MappedFile file;
+    if (mapFile(cacheName, &file) != 0)
+        return 0;
+
+    CacheHeader header;
+    if (file.size < sizeof(header)) {
+        unmapFile(&file);
+        return 0;
+    }
+    memcpy(&header, file.data, sizeof(header));
+    const OpReader reader = {(const unsigned char *) file.data + sizeof(header),
+                             (const unsigned char *) file.data + file.size, 0};
+
+    // nothing may have happened yet when a stale or damaged cache turns up, so it is read through once first
+    int created, checkedLine;
+    if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.hash != hash ||
+        runOps(reader, header.countOps, NULL, &created, &checkedLine) != 0 || created != (int) header.countObjects) {
+        unmapFile(&file);
+        return 0;
+    }
+
+    GeomObject **objects = malloc(sizeof(GeomObject *) * (header.countObjects ? header.countObjects : 1));
+    *error = runOps(reader, header.countOps, objects, &created, line);
+    free(objects);
+    unmapFile(&file);
+    return 1;
+}
@@ -0,0 +1,87 @@
+#include "slab.h"
+
+#include <stdlib.h>
+
+struct SlabChunk_ {
+    SlabChunk *next;
+    size_t capacity; // also keeps records 16-byte aligned
+};
+
+static Slab *slabs = NULL;
+
+static void newChunk(Slab *slab, const int capacity) {
+    if (!slab->registered) {
+        slab->registered = 1;
+        slab->nextSlab = slabs;
+        slabs = slab;
+    }
+
+    const size_t bytes = sizeof(SlabChunk) + slab->elemSize * capacity;
+    SlabChunk *chunk = malloc(bytes);
+    chunk->next = slab->chunks;
+    chunk->capacity = capacity;
+    slab->chunks = chunk;
+    slab->chunkUsed = 0;
+    slab->chunkBytes += bytes;
+    ++slab->chunkCount;
+}
+
+void *slabAlloc(Slab *slab) {
+    ++slab->allocCount;
+
+    if (slab->freeList != NULL) {
+        void *ptr = slab->freeList;
+        slab->freeList = *(void **) ptr;
+        return ptr;
+    }
+
+    if (slab->chunks == NULL || slab->chunkUsed == (int) slab->chunks->capacity)
+        newChunk(slab, slab->chunkCapacity);
+
+    return (char *) (slab->chunks + 1) + slab->elemSize * slab->chunkUsed++;
+}
+
+void slabFree(Slab *slab, void *ptr) {
+    *(void **) ptr = slab->freeList;
+    slab->freeList = ptr;
+    ++slab->freeCount;
+}
+
+// the next count records come out of one chunk, unless the free list has them.
+// whatever was left of the current chunk is not used any more
+void slabReserve(Slab *slab, const int count) {
+    if (slab->freeList != NULL)
+        return;
+    if (slab->chunks != NULL && (int) slab->chunks->capacity - slab->chunkUsed >= count)
+        return;
+    newChunk(slab, count > slab->chunkCapacity ? count : slab->chunkCapacity);
+}
+
+// drop every record at once; the counters keep running for the stats
+void slabRelease(Slab *slab) {
+    SlabChunk *chunk = slab->chunks;
+    while (chunk != NULL) {
+        SlabChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    slab->freeCount = slab->allocCount;
+    slab->chunks = NULL;
+    slab->chunkUsed = 0;
+    slab->chunkCount = 0;
+    slab->chunkBytes = 0;
+    slab->freeList = NULL;
+}
+
+long long slabLiveCount(const Slab *slab) {
+    return slab->allocCount - slab->freeCount;
+}
+
+size_t slabBytes(const Slab *slab) {
+    return slab->chunkBytes;
+}
+
+const Slab *slabList() {
+    return slabs;
+}
@@ -0,0 +1,108 @@
+#include "spatial_index.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// uniform grid over math coordinates. cells hash into a fixed number of buckets, so the grid
+// has no edges, and objects from far apart cells may share a bucket. callers test every candidate
+#define CELL_SIZE 32.f
+#define BUCKET_COUNT 4096
+#define MAX_CELL_SPAN 16
+
+typedef struct {
+    GeomObject **objs;
+    int count, capacity;
+} Bucket;
+
+static Bucket buckets[BUCKET_COUNT];
+
+// lines, rays, and anything spanning more than MAX_CELL_SPAN cells on an axis
+static Bucket unbounded;
+
+static inline Bucket *getBucket(const int x, const int y) {
+    return buckets + (((unsigned) x * 73856093u ^ (unsigned) y * 19349663u) & (BUCKET_COUNT - 1));
+}
+
+static void bucketPush(Bucket *bucket, GeomObject *obj) {
+    if (bucket->count == bucket->capacity)
+        bucket->objs = realloc(bucket->objs, sizeof(GeomObject *) * (bucket->capacity = bucket->capacity ? bucket->capacity * 2 : 8));
+    bucket->objs[bucket->count++] = obj;
+}
+
+static void bucketErase(Bucket *bucket, const GeomObject *obj) {
+    for (int i = 0; i < bucket->count; ++i) {
+        if (bucket->objs[i] == obj) {
+            bucket->objs[i] = bucket->objs[--bucket->count];
+            return;
+        }
+    }
+}
+
+void spatialIndexRemove(GeomObject *obj) {
+    if (obj->flags & OBJECT_UNBOUNDED) {
+        bucketErase(&unbounded, obj);
+        obj->flags &= ~OBJECT_UNBOUNDED;
+        return;
+    }
+
+    const Rect2i cells = obj->cells;
+    for (int y = cells.y; y < cells.y + cells.height; ++y)
+        for (int x = cells.x; x < cells.x + cells.width; ++x)
+            bucketErase(getBucket(x, y), obj);
+    obj->cells = (Rect2i){0};
+}
+
+// files the object under every cell its bounding box [min, max] touches
+void spatialIndexUpdate(GeomObject *obj, const Point2f min, const Point2f max) {
+    spatialIndexRemove(obj);
+
+    const float x0 = floorf(min.x / CELL_SIZE), y0 = floorf(min.y / CELL_SIZE);
+    const float x1 = floorf(max.x / CELL_SIZE), y1 = floorf(max.y / CELL_SIZE);
+    // also catches inf and nan, and cells too far out to number with an int
+    if (!(x1 - x0 < MAX_CELL_SPAN && y1 - y0 < MAX_CELL_SPAN && fabsf(x0) < 0x1000000 && fabsf(y0) < 0x1000000)) {
+        obj->flags |= OBJECT_UNBOUNDED;
+        bucketPush(&unbounded, obj);
+        return;
+    }
+
+    obj->cells = (Rect2i){(int) x0, (int) y0, (int) (x1 - x0) + 1, (int) (y1 - y0) + 1};
+    for (int y = obj->cells.y; y < obj->cells.y + obj->cells.height; ++y)
+        for (int x = obj->cells.x; x < obj->cells.x + obj->cells.width; ++x)
+            bucketPush(getBucket(x, y), obj);
+}
+
+static Bucket found;
+
+static void collect(const Bucket *bucket) {
+    for (int i = 0; i < bucket->count; ++i)
+        bucketPush(&found, bucket->objs[i]);
+}
+
+// objects filed under any cell touching [min, max], plus the unbounded ones. cells sharing a
+// bucket list their objects again, so an object may come up more than once
+int spatialIndexQuery(const Point2f min, const Point2f max, GeomObject *const **candidates) {
+    found.count = 0;
+    collect(&unbounded);
+
+    const float x0 = floorf(min.x / CELL_SIZE), y0 = floorf(min.y / CELL_SIZE);
+    const float x1 = floorf(max.x / CELL_SIZE), y1 = floorf(max.y / CELL_SIZE);
+    // more cells than buckets, every bucket would come up anyway
+    if (!((x1 - x0 + 1) * (y1 - y0 + 1) <= BUCKET_COUNT && fabsf(x0) < 0x1000000 && fabsf(y0) < 0x1000000)) {
+        for (int i = 0; i < BUCKET_COUNT; ++i)
+            collect(buckets + i);
+    } else {
+        for (int y = (int) y0; y <= (int) y1; ++y)
+            for (int x = (int) x0; x <= (int) x1; ++x)
+                collect(getBucket(x, y));
+    }
+
+    *candidates = found.objs;
+    return found.count;
+}
+
+// the objects themselves are gone already, only forget them
+void spatialIndexClear() {
+    for (int i = 0; i < BUCKET_COUNT; ++i)
+        buckets[i].count = 0;
+    unbounded.count = 0;
+}
@@ -0,0 +1,192 @@
+#include "stats.h"
+#include "board.h"
+#include "draw_batch.h"
+#include "geom_errors.h"
+#include "graphical.h"
+#include "object.h"
+#include "slab.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern Window *imageWindow;
+
+static int allocStats() {
+    static char summary[96];
+    long long live = 0, allocs = 0;
+    size_t bytes = 0;
+    int chunks = 0;
+
+    for (const Slab *slab = slabList(); slab != NULL; slab = slab->nextSlab) {
+        printf("%-12s %10lld live %10lld allocs %6d chunks %8zu KiB\n", slab->name,
+               slabLiveCount(slab), slab->allocCount, slab->chunkCount, slabBytes(slab) >> 10);
+        live += slabLiveCount(slab);
+        allocs += slab->allocCount;
+        chunks += slab->chunkCount;
+        bytes += slabBytes(slab);
+    }
+
+    snprintf(summary, sizeof(summary), "%lld live / %lld allocs, %d chunks, %zu KiB", live, allocs, chunks,
+             bytes >> 10);
+    return showMessage(summary);
+}
+
+static int renderStats() {
+    static char summary[128];
+    const RenderStats *frame = getRenderStats();
+
+    printf("frame       %10.3f ms\n", frame->frameMs);
+    printf("fill        %10.3f ms\n", frame->fillMs);
+    printf("circles     %10.3f ms\n", frame->circleMs);
+    printf("lines       %10.3f ms\n", frame->lineMs);
+    printf("points      %10.3f ms\n", frame->pointMs);
+    printf("propagation %10.3f ms\n", frame->propagationMs);
+    printf("drawn       %10d\nculled      %10d\n", frame->drawn, frame->culled);
+
+    snprintf(summary, sizeof(summary), "frame %.2f ms, fill %.2f, draw %.2f/%.2f/%.2f, %d drawn, %d culled",
+             frame->frameMs, frame->fillMs, frame->circleMs, frame->lineMs, frame->pointMs, frame->drawn,
+             frame->culled);
+    return showMessage(summary);
+}
+
+static int statsOverlay(const int argc, const char **argv) {
+    if (argc < 3)
+        return throwError(ERROR_NOT_ENOUGH_ARG, notEnoughArg(*argv));
+
+    const char *end;
+    const int on = strtobool(argv[2], &end);
+    if (*end != '\0')
+        return throwError(ERROR_INVALID_ARG, invalidArg("overlay", "Please true/false"));
+
+    setStatsOverlay(on);
+    refreshBoard();
+    return 0;
+}
+
+int stats(const int argc, const char **argv) {
+    if (argc == 1)
+        return throwError(ERROR_NO_ARG_GIVEN, noArgGiven(*argv));
+
+    switch (strhash64(argv[1])) {
+        case STR_HASH64('a', 'l', 'l', 'o', 'c', 0, 0, 0):
+            return allocStats();
+        case STR_HASH64('r', 'e', 'n', 'd', 'e', 'r', 0, 0):
+            return renderStats();
+        case STR_HASH64('o', 'v', 'e', 'r', 'l', 'a', 'y', 0):
+            return statsOverlay(argc, argv);
+        default:
+            return throwError(ERROR_INVALID_ARG, invalidArg("stats", "Please alloc, render or overlay"));
+    }
+}
+
+// moves the point onto itself reps times for every thread count from 1 to the core count
+static int benchMove(const int argc, const char **argv) {
+    static char summary[128];
+
+    if (argc < 3)
+        return throwError(ERROR_NOT_ENOUGH_ARG, notEnoughArg(*argv));
+
+    const GeomObject *obj = findObject(POINT, argv[2]);
+    if (obj == NULL)
+        return throwError(ERROR_NOT_FOUND_OBJECT, objectNotFound(argv[2]));
+
+    int reps = 100;
+    if (argc >= 4) {
+        char *end;
+        reps = (int) strtol(argv[3], &end, 10);
+        if (*end != '\0' || reps <= 0)
+            return throwError(ERROR_INVALID_ARG, invalidArg("reps", NULL));
+    }
+
+    PointObject *pt = obj->ptr->point;
+    const Point2f coord = pointCoord(pt);
+    const int maxThreads = getMaxThreads(), userThreads = getPropagationThreads();
+    double serial = 0;
+    int length = snprintf(summary, sizeof(summary), "move x%d:", reps);
+
+    for (int threads = 1; threads <= maxThreads; ++threads) {
+        setPropagationThreads(threads);
+        movePoints(&pt, &coord, 1); // warm up the plan cache
+
+        const double start = getTimeMs();
+        for (int i = 0; i < reps; ++i)
+            movePoints(&pt, &coord, 1);
+        const double elapsed = getTimeMs() - start;
+
+        if (threads == 1)
+            serial = elapsed;
+        printf("%2d threads %10.3f ms %6.2fx\n", threads, elapsed, serial / elapsed);
+        if (length < (int) sizeof(summary))
+            length += snprintf(summary + length, sizeof(summary) - length, " %dt %.1fms", threads, elapsed);
+    }
+    setPropagationThreads(userThreads);
+
+    return showMessage(summary);
+}
+
+// repaints the whole board reps times for every thread count from 1 to the core count.
+// every count must give the same pixels as the one-thread pass
+static int benchRender(const int argc, const char **argv) {
+    static char summary[128];
+
+    int reps = 20;
+    if (argc >= 3) {
+        char *end;
+        reps = (int) strtol(argv[2], &end, 10);
+        if (*end != '\0' || reps <= 0)
+            return throwError(ERROR_INVALID_ARG, invalidArg("reps", NULL));
+    }
+
+    const size_t frameSize = (size_t) imageWindow->width * imageWindow->height * 3;
+    unsigned char *serialFrame = malloc(frameSize), *frame = malloc(frameSize);
+    const int maxThreads = getMaxThreads(), userThreads = getRasterThreads();
+    double serial = 0;
+    int mismatches = 0;
+    int length = snprintf(summary, sizeof(summary), "render x%d:", reps);
+
+    for (int threads = 1; threads <= maxThreads; ++threads) {
+        setRasterThreads(threads);
+        invalidateBoard();
+        forceRefresh();
+
+        const double start = getTimeMs();
+        for (int i = 0; i < reps; ++i) {
+            invalidateBoard();
+            forceRefresh();
+        }
+        const double elapsed = getTimeMs() - start;
+
+        windowRead(imageWindow, threads == 1 ? serialFrame : frame);
+        const int same = threads == 1 || memcmp(serialFrame, frame, frameSize) == 0;
+        mismatches += !same;
+
+        if (threads == 1)
+            serial = elapsed;
+        printf("%2d threads %10.3f ms %6.2fx%s\n", threads, elapsed, serial / elapsed, same ? "" : " MISMATCH");
+        if (length < (int) sizeof(summary))
+            length += snprintf(summary + length, sizeof(summary) - length, " %dt %.1fms", threads, elapsed);
+    }
+    setRasterThreads(userThreads);
+    free(serialFrame);
+    free(frame);
+
+    if (mismatches != 0 && length < (int) sizeof(summary))
+        snprintf(summary + length, sizeof(summary) - length, ", %d mismatched", mismatches);
+    return showMessage(summary);
+}
+
+int bench(const int argc, const char **argv) {
+    if (argc == 1)
+        return throwError(ERROR_NO_ARG_GIVEN, noArgGiven(*argv));
+
+    switch (strhash64(argv[1])) {
+        case STR_HASH64('m', 'o', 'v', 'e', 0, 0, 0, 0):
+            return benchMove(argc, argv);
+        case STR_HASH64('r', 'e', 'n', 'd', 'e', 'r', 0, 0):
+            return benchRender(argc, argv);
+        default:
+            return throwError(ERROR_INVALID_ARG, invalidArg("bench", "Please move or render"));
+    }
+}
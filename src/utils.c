@@ -1,6 +1,7 @@
 #include "utils.h"
 #include "geom_errors.h"
 #include <string.h>
+#include <time.h>
 
 typedef struct pcg_state_setseq_64 {
     uint64_t state;
@@ -27,7 +28,7 @@ void randomSeed(const uint64_t initstate, const uint64_t initseq) {
 
 const char *invalidColor() {
     static const char *tips = "Please use hexadecimal.";
-    static char error[40] = {0};
+    static char error[64] = {0};
 
     if (*error == 0)
         strcpy(error, invalidArg("color", tips));
@@ -45,6 +46,21 @@ uint64_t strhash64(const char *str) {
     return hash;
 }
 
+// FNV-1a
+uint64_t hashBytes(const char *data, const size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= (unsigned char) data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// over the whole string, unlike strhash64 which only packs the first 8 chars
+uint64_t hashString(const char *str) {
+    return hashBytes(str, strlen(str));
+}
+
 int strtobool(const char *str, const char **endptr) {
     switch (strhash64(str)) {
         case STR_HASH64('t', 'r', 'u', 'e', 0, 0, 0, 0):
@@ -58,3 +74,9 @@ int strtobool(const char *str, const char **endptr) {
             return 0;
     }
 }
+
+double getTimeMs() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double) ts.tv_sec * 1e3 + (double) ts.tv_nsec / 1e6;
+}